@@ -0,0 +1,124 @@
+/**@file exediff_bench.cpp -- benchmark of exediff compare engine.
+ * 傫PEt@C̑gƃtH_ɐAIvV Compare ̏vԂ𑪂.
+ * 2ڈȍ~ Compare ̓C[WLbVɍڂԂł̔rԂƂȂ.
+ *
+ * 茋ʂ͕WG[ɏo͂ACompare ̔rʂ͎̂Ă.
+ *
+ * usage: exediff_bench [DIR [SIZE_MB [REPEAT]]]
+ * @author Hiroshi Kuno <hkuno-exediff-tool@microhouse.co.jp>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#define MKDIR(dir)	_mkdir(dir)
+#define NULL_DEVICE	"NUL"
+#else
+#include <time.h>
+#include <sys/stat.h>
+#define MKDIR(dir)	mkdir(dir, 0777)
+#define NULL_DEVICE	"/dev/null"
+#endif
+#include "exediff.h"
+#include "../test/mkpe.h"
+
+/** oߎԂbŕԂ. */
+static double now()
+{
+#ifdef _WIN32
+	LARGE_INTEGER freq, count;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (double)count.QuadPart / freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+/** 肷IvV̑gݍ킹. */
+struct BenchMode {
+	const char* name;
+	bool brief;
+	bool all;
+	bool profile;
+};
+
+static const BenchMode gModes[] = {
+	{ "-q",      false, false, false },
+	{ "--brief", true,  false, false },
+	{ "-q -a",   false, true,  false },
+	{ "-q -e",   false, false, true  },
+};
+
+/** rt@C̑g. */
+struct BenchPair {
+	const char* name;
+	const char* file2;
+};
+
+static const BenchPair gPairs[] = {
+	{ "identical",  "same.dll"  },
+	{ "tail differ", "patch.dll" },
+};
+
+/** C֐ */
+int main(int argc, char* argv[])
+{
+	const char* dir = argc > 1 ? argv[1] : "bench_data";
+	const unsigned size_mb = argc > 2 ? atoi(argv[2]) : 64;
+	const int repeat = argc > 3 ? atoi(argv[3]) : 5;
+	if (MKDIR(dir) != 0 && errno != EEXIST) {
+		fprintf(stderr, "%s: %s\n", dir, strerror(errno));
+		return 2;
+	}
+
+	//--- rΏۂ𐶐. patch.dll  .text ̖t߂قȂ.
+	char base[1024], same[1024], patch[1024];
+	sprintf(base,  "%s/base.dll",  dir);
+	sprintf(same,  "%s/same.dll",  dir);
+	sprintf(patch, "%s/patch.dll", dir);
+	const unsigned text = size_mb * 0x100000;
+	PeSpec spec = { 0x40000000, -1, NULL, text };
+	bool ok = write_pe(base, spec) && write_pe(same, spec);
+	spec.patch = text - 0x1000;
+	ok = ok && write_pe(patch, spec);
+	if (!ok) {
+		fprintf(stderr, "%s: %s\n", dir, strerror(errno));
+		return 2;
+	}
+
+	//--- IvVɔrԂ𑪂.
+	gQuiet = true;
+	freopen(NULL_DEVICE, "w", stdout);
+	gCacheBudget = size_mb * 4 + 16;	// 3t@CLbVɎ܂悤ɂ.
+	fprintf(stderr, "%-8s %-12s %10s %10s %10s\n", "mode", "pair", "first(ms)", "best(ms)", "MB/s");
+	for (size_t m = 0; m < sizeof(gModes) / sizeof(gModes[0]); ++m) {
+		const BenchMode& mode = gModes[m];
+		gBrief = mode.brief;
+		gDiffLength = mode.brief ? 0 : 4;
+		gCompareAll = mode.all;
+		gProfile = mode.profile;
+		for (size_t p = 0; p < sizeof(gPairs) / sizeof(gPairs[0]); ++p) {
+			sprintf(same, "%s/%s", dir, gPairs[p].file2);
+			double first = 0, best = 0;
+			for (int i = 0; i < repeat; ++i) {
+				double t0 = now();
+				if (Compare(base, same) == 2)
+					return 2;
+				double t = now() - t0;
+				if (i == 0)
+					first = best = t;
+				else if (t < best)
+					best = t;
+			}
+			fprintf(stderr, "%-8s %-12s %10.2f %10.2f %10.0f\n", mode.name, gPairs[p].name,
+				first * 1e3, best * 1e3, best > 0 ? size_mb / best : 0.0);
+		}
+	}
+	return 0;
+}
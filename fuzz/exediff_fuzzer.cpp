@@ -0,0 +1,58 @@
+/**@file exediff_fuzzer.cpp -- libFuzzer harness for exediff.
+ * ͂񕪂ēPEC[WƂēǂݍ݁A_vƔrs.
+ * ǂݍݎ͈̔͌(ExeFileImage::validate)ƔrGWΏۂƂ.
+ *
+ * build: clang++ -g -O1 -fsanitize=fuzzer,address -DEXEDIFF_NO_MAIN fuzz/exediff_fuzzer.cpp
+ * libFuzzerōČɂ -DEXEDIFF_FUZZ_STANDALONE `Aɓ̓t@Cׂ.
+ */
+#include "../src/exediff.cpp"
+
+#ifdef _WIN32
+#define NULL_DEVICE	"NUL"
+#else
+#define NULL_DEVICE	"/dev/null"
+#endif
+
+extern "C" int LLVMFuzzerInitialize(int* /*argc*/, char*** /*argv*/)
+{
+	gQuiet = true;
+	gDumpFileImage = true;
+	gCompareAll = true;
+	freopen(NULL_DEVICE, "w", stdout);	// rʂƃ_v͎̂Ă.
+	return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uchar* data, size_t size)
+{
+	size_t half = size / 2;
+	ExeFileImage f1("fuzz1", data, half);
+	ExeFileImage f2("fuzz2", data + half, size - half);
+	if (f1.IsLoaded() && f2.IsLoaded()) {
+		Compare(f1, f2);
+		NameSet names;
+		f1.GetExports(names);
+		f1.GetImports(names);
+	}
+	return 0;
+}
+
+#ifdef EXEDIFF_FUZZ_STANDALONE
+/** ̓t@C LLVMFuzzerTestOneInput ɗ^. */
+int main(int argc, char* argv[])
+{
+	LLVMFuzzerInitialize(&argc, &argv);
+	for (int i = 1; i < argc; ++i) {
+		FILE* fp = fopen(argv[i], "rb");
+		if (fp == NULL) {
+			perror(argv[i]);
+			return EXIT_FAILURE;
+		}
+		static uchar buf[16*1024*1024];
+		size_t n = fread(buf, 1, sizeof(buf), fp);
+		fclose(fp);
+		LLVMFuzzerTestOneInput(buf, n);
+		fprintf(stderr, "%s: %u bytes done\n", argv[i], (unsigned)n);
+	}
+	return EXIT_SUCCESS;
+}
+#endif
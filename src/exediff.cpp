@@ -2,18 +2,38 @@
  * $Id: exediff.cpp,v 1.11 2004/06/30 06:59:44 hkuno Exp $
  * @author Hiroshi Kuno <hkuno-exediff-tool@microhouse.co.jp>
  */
+#ifdef _WIN32
 #include <windows.h>
 #include <imagehlp.h>
 #pragma comment(lib, "imagehlp.lib")
+#include <mbstring.h>
+#include <io.h>
+#else
+#include "posix.h"		// Win32/imagehlp/CRT ̑.
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <signal.h>
+#endif
+#ifdef __linux__
+#include <dirent.h>
+#include <sys/syscall.h>
+#endif
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
-#include <mbstring.h>
-#include <io.h>
+#include <ctype.h>
+#include <errno.h>
 #include <locale.h>
 #include <time.h>
+#include <math.h>
+#include "exediff.h"
 //using namespace std;
 
 //------------------------------------------------------------------------
@@ -47,10 +67,41 @@ size_t gDiffLength = 4;
 /** directory diff mode */
 bool gDirDiff = false;
 
+/** serving mode: requests may come from any working directory */
+bool gServing = false;
+
+/** -s: write snapshot of FILE2/DIR2 into FILE1/DIR1 */
+bool gWriteSnapshot = false;
+
+/** -b#: block size of snapshot hashes */
+size_t gSnapshotBlockSize = 4096;
+
+/** -a: compare all bytes (header slack, section padding, certificate and overlay) */
+bool gCompareAll = false;
+
+/** -m#: memory budget of image cache in MB */
+size_t gCacheBudget = 256;
+
+/** -p#: number of file pairs to prefetch in directory mode */
+size_t gPrefetchCount = 4;
+
+/** --brief: report only whether files differ, stop at the first difference */
+bool gBrief = false;
+
+/** -j#: number of threads to scan a section in --brief mode. 0 is number of processors */
+size_t gThreads = 0;
+
+/** -r#: pair renamed files whose similarity is at least # percent in directory mode. 0 is off */
+size_t gRenameThreshold = 0;
+
+/** -e: profile byte entropy and zero runs of section data */
+bool gProfile = false;
+
 //........................................................................
 // messages
 /** short help-message */
-const char* gUsage  = "usage :exediff [-h?tcdq][-n#] (FILE1 FILE2 | DIR1 DIR2 [WILD] | DIR1 DIR2\\WILD)\n";
+const char* gUsage  = "usage :exediff [-h?tcdqsae][-n#][-b#][-m#][-p#][-j#][-r#][--brief][--connect=SOCKET] (FILE1 FILE2 | DIR1 DIR2 [WILD] | DIR1 DIR2\\WILD)\n"
+					  "       exediff [-q][-m#] --serve=SOCKET [BASELINE...]\n";
 
 /** detail help-message for options and version */
 const char* gUsage2 =
@@ -61,8 +112,21 @@ const char* gUsage2 =
 	"  -d      dump file image\n"
 	"  -q      quiet mode\n"
 	"  -n#     max length of differ rawdatas. default is 4\n"
-	"  FILE1/2 compare exe/dll file\n"
-	"  DIR1/2  compare folder\n"
+	"  -s      write snapshot of FILE2/DIR2 into FILE1/DIR1\n"
+	"  -b#     block size of snapshot hashes. default is 4096\n"
+	"  -a      compare all bytes: header slack, section padding, certificate, overlay\n"
+	"  -e      profile entropy and zero runs of dumped or differing sections\n"
+	"  -m#     memory budget(MB) of loaded image cache. default is 256\n"
+	"  -p#     prefetch next # file pairs in directory mode. default is 4\n"
+	"  --brief report only whether files differ. stop at the first difference\n"
+	"  -j#     number of threads to scan large sections in --brief mode. default is all processors\n"
+	"  -r#     pair renamed files in directory mode by content similarity(%). -r is -r50\n"
+	"  --serve=SOCKET    serve compare requests on unix socket. keep BASELINE file/dir/zip images cached\n"
+	"  --connect=SOCKET  request the compare to the server. environment EXEDIFF_SERVER is used if not specified,\n"
+	"                    and exediff compares by itself when the server is not running\n"
+	"  FILE1/2 compare exe/dll file. ZIP!MEMBER means a member of zip archive\n"
+	"          FILE1 may be a snapshot written by -s\n"
+	"  DIR1/2  compare folder or zip archive\n"
 	"  WILD    compare files pattern in DIR2. default is *\n"
 	;
 
@@ -95,13 +159,17 @@ void errorf_abort(const char* fmt, ...)
 	exit(EXIT_FAILURE);
 }
 
-/** G[bZ[WƁAWin32̏ڍ׃G[\ */
+/** G[bZ[WƁAWin32̏ڍ׃G[\. POSIXł errno ̏\. */
 void print_win32error(const char* msg)
 {
 	DWORD win32error = ::GetLastError();
+#ifdef _WIN32
 	char buf[1000];
 	::FormatMessageA(FORMAT_MESSAGE_FROM_SYSTEM, NULL, win32error, 0, buf, sizeof(buf), NULL);
 	fprintf(stderr, "%s: Win32Error(%d) %s", msg, win32error, buf);
+#else
+	fprintf(stderr, "%s: Error(%d) %s\n", msg, win32error, strerror(win32error));
+#endif
 }
 //@}
 
@@ -265,11 +333,30 @@ bool FindFile::IsDotFolder() const
 }
 
 //------------------------------------------------------------------------
+#ifdef _WIN32
+/** t@C𓾂. ݂Ȃ-1. */
+inline DWORD get_file_attributes(const char* path)
+{
+	return ::GetFileAttributes(path);
+}
+#else
+const DWORD FILE_ATTRIBUTE_DIRECTORY = 0x10;
+
+/** t@C stat  GetFileAttributes Ɠlɓ. ݂Ȃ-1ԂAerrnoɗRc. */
+DWORD get_file_attributes(const char* path)
+{
+	struct stat st;
+	if (stat(path, &st) != 0)
+		return (DWORD)-1;
+	return S_ISDIR(st.st_mode) ? FILE_ATTRIBUTE_DIRECTORY : 0;
+}
+#endif
+
 /** ݂tH_ł邱Ƃۏ؂. 肪ΏI. */
 void ValidateFolder(const char* dir)
 {
-	DWORD attr = ::GetFileAttributes(dir);
-	if (attr == -1) {
+	DWORD attr = get_file_attributes(dir);
+	if (attr == (DWORD)-1) {
 		print_win32error(dir);
 		error_abort();
 	}
@@ -281,243 +368,1692 @@ void ValidateFolder(const char* dir)
 /** ݂tH_ł邱ƂmF. */
 bool IsExistFolder(const char* dir)
 {
-	DWORD attr = ::GetFileAttributes(dir);
-	return (attr != -1) && (attr & FILE_ATTRIBUTE_DIRECTORY) != 0;
+	DWORD attr = get_file_attributes(dir);
+	return (attr != (DWORD)-1) && (attr & FILE_ATTRIBUTE_DIRECTORY) != 0;
 }
 
 /** ݂t@Cł邱ƂmF. */
 bool IsExistFile(const char* fname)
 {
-	DWORD attr = ::GetFileAttributes(fname);
-	return (attr != -1) && (attr & FILE_ATTRIBUTE_DIRECTORY) == 0;
+	DWORD attr = get_file_attributes(fname);
+	return (attr != (DWORD)-1) && (attr & FILE_ATTRIBUTE_DIRECTORY) == 0;
+}
+
+/** t@C̏o邽߂́A傫ƍŏIXV. */
+struct FileStamp {
+	unsigned long long size;
+	unsigned long long mtime;	///< Win32łFILETIMEAPOSIXł̓imbP.
+
+	bool operator==(const FileStamp& x) const {
+		return size == x.size && mtime == x.mtime;
+	}
+};
+
+/** t@C̑傫ƍŏIXV𓾂.
+ * @return Ȃtrue. sGetLastError()ɗRc.
+ */
+bool get_file_stamp(const char* path, FileStamp& stamp)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA fad;
+	if (!::GetFileAttributesEx(path, GetFileExInfoStandard, &fad))
+		return false;
+	stamp.size  = ((unsigned long long)fad.nFileSizeHigh << 32) | fad.nFileSizeLow;
+	stamp.mtime = ((unsigned long long)fad.ftLastWriteTime.dwHighDateTime << 32) | fad.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat st;
+	if (stat(path, &st) != 0)
+		return false;
+	stamp.size  = st.st_size;
+#ifdef __linux__
+	stamp.mtime = st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+#else
+	stamp.mtime = st.st_mtime * 1000000000ULL;
+#endif
+#endif
+	return true;
 }
 
 //------------------------------------------------------------------------
-/** PE format file image */
-class ExeFileImage : public LOADED_IMAGE {
-	BOOL mLoaded;
-	ExeFileImage(const ExeFileImage&);		// don't copy
-	void operator=(const ExeFileImage&);	// don't assign
+///@name t@C̍Əƍ
+//@{
+/** ASCIIpɂ. P[ɈˑȂ. */
+inline uchar fold_char(uchar c)
+{
+	return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+/** 啶𖳎nbVl(FNV-1a).
+ * 2oCǧ㑱oCgݍނAstriequ œO͕KlɂȂ.
+ */
+ulong fold_hash(const char* s)
+{
+	ulong h = 2166136261UL;
+	for (const uchar* p = (const uchar*)s; *p; ++p)
+		h = ((h ^ fold_char(*p)) * 16777619UL) & 0xFFFFFFFFUL;
+	return h;
+}
+
+/** 啶𖳎閼O̍. nbV\(JԒn@)ŁAO1萔Ԃň.
+ * O͕̕ʂȂ. O͍蒷邱.
+ */
+class NameIndex {
+	struct Slot {
+		const char* name;	///< NULLȂ.
+		size_t value;
+	};
+	Slot* mSlots;
+	size_t mMask;			///< Xbg-1. Xbg2̙p.
+	size_t mCount;
+	NameIndex(const NameIndex&);		// don't copy
+	void operator=(const NameIndex&);	// don't assign
+
+	Slot* lookup(const char* name) const;
+	void grow();
 public:
-	ExeFileImage(const char* fname);
+	NameIndex() : mSlots(NULL), mMask(0), mCount(0) {}
 
-	~ExeFileImage();
+	~NameIndex() {
+		free(mSlots);
+	}
 
-	void print() const;
+	/** Oƕtl. 啶ႤOɂ΁Aɉc. */
+	void Add(const char* name, size_t value = 0);
 
-	bool IsLoaded() const {
-		return mLoaded == TRUE;
+	/** 啶𖳎ĖOT.
+	 * @param value	O̕tl̊i[(svȂNULL).
+	 * @return ̒Ԃ̖O. NULL.
+	 */
+	const char* Find(const char* name, size_t* value = NULL) const;
+
+	size_t Count() const {
+		return mCount;
 	}
 };
 
-ExeFileImage::ExeFileImage(const char* fname)
+NameIndex::Slot* NameIndex::lookup(const char* name) const
 {
-	mLoaded = ::MapAndLoad(const_cast<char*>(fname), ".", this, TRUE, TRUE);
+	size_t i = fold_hash(name) & mMask;
+	while (mSlots[i].name != NULL && !striequ(mSlots[i].name, name))
+		i = (i + 1) & mMask;
+	return &mSlots[i];
 }
 
-ExeFileImage::~ExeFileImage()
+void NameIndex::grow()
 {
-	if (mLoaded)
-		::UnMapAndLoad(this);
+	Slot* old = mSlots;
+	size_t n = mSlots ? mMask + 1 : 0;
+	mMask = n ? n * 2 - 1 : 255;
+	mSlots = (Slot*)calloc(mMask + 1, sizeof(Slot));
+	if (mSlots == NULL)
+		error_abort("out of memory\n");
+	for (size_t i = 0; i < n; ++i) {
+		if (old[i].name != NULL)
+			*lookup(old[i].name) = old[i];
+	}
+	free(old);
 }
 
-/** \Ԃ. s\ɑ΂Ă'.'Ԃ */
-inline int ascii(int c)
+void NameIndex::Add(const char* name, size_t value)
 {
-	return (!iscntrl(c) && isprint(c)) ? c : '.';
+	if (mSlots == NULL || (mCount + 1) * 2 > mMask + 1)	// gp1/2ȉɕۂ.
+		grow();
+	Slot* slot = lookup(name);
+	if (slot->name != NULL)
+		return;
+	slot->name = name;
+	slot->value = value;
+	++mCount;
 }
 
-const char* ImageCharacteristicsString(WORD flags, char* buf=NULL)
+const char* NameIndex::Find(const char* name, size_t* value) const
 {
-	static char mybuf[20*16];
-	if (!buf) buf = mybuf;
-	sprintf(buf, "%04X(", flags);
+	if (mSlots == NULL)
+		return NULL;
+	const Slot* slot = lookup(name);
+	if (slot->name != NULL && value != NULL)
+		*value = slot->value;
+	return slot->name;
+}
 
-	#define M(f, id)	if (flags & f) strcat(buf, id ", ")
-	M(IMAGE_FILE_RELOCS_STRIPPED, "relocations stripped");		// Relocation information is stripped from the file. 
-	M(IMAGE_FILE_EXECUTABLE_IMAGE, "executable image");			// The file is executable (there are no unresolved external references). 
-	M(IMAGE_FILE_LINE_NUMS_STRIPPED, "linenumbers stripped");	// Line numbers are stripped from the file. 
-	M(IMAGE_FILE_LOCAL_SYMS_STRIPPED, "symbols stripped");		// Local symbols are stripped from file. 
-	M(IMAGE_FILE_AGGRESIVE_WS_TRIM, "AGGRESIVE_WS_TRIM");		// Aggressively trim the working set. 
-	M(IMAGE_FILE_LARGE_ADDRESS_AWARE, "LARGE_ADDRESS_AWARE");	// The application can handle addresses larger than 2 GB. 
-	M(IMAGE_FILE_BYTES_REVERSED_LO, "BYTES_REVERSED_LO");		// Bytes of the word are reversed. 
-	M(IMAGE_FILE_32BIT_MACHINE,  "32BIT_MACHINE");				// Computer supports 32-bit words. 
-	M(IMAGE_FILE_DEBUG_STRIPPED, "debuginfo stripped");			// Debugging information is stored separately in a .dbg file. 
-	M(IMAGE_FILE_REMOVABLE_RUN_FROM_SWAP, "REMOVABLE_RUN_FROM_SWAP");// If the image is on removable media, copy and run from the swap file. 
-	M(IMAGE_FILE_NET_RUN_FROM_SWAP, "NET_RUN_FROM_SWAP");		// If the image is on the network, copy and run from the swap file. 
-	M(IMAGE_FILE_SYSTEM, "system file");						// SYSTEM System file. 
-	M(IMAGE_FILE_DLL, "DLL file");								//  DLL file. 
-	M(IMAGE_FILE_UP_SYSTEM_ONLY, "UP_SYSTEM_ONLY");				// File should be run only on a uniprocessor computer. 
-	M(IMAGE_FILE_BYTES_REVERSED_HI, "BYTES_REVERSED_HI");		// Bytes of the word are reversed. 
-	#undef M
+/** ͍ς݂̃ChJ[h. '*'ŋ؂fЂƂɏƍAǑ߂fЂ̒Tɗ}.
+ * 啶͖A'*''/'܂߂Cӂ̕Ƀ}b`.
+ */
+class WildPattern {
+	struct Piece {
+		const char* text;	///< ς. '?'͔Cӂ1.
+		size_t len;
+	};
+	char* mText;
+	Piece* mPieces;			///< '*'ŋ؂f. '*'̐+1.
+	size_t mCount;
+	bool mAny;				///< "*"ȂǁASĂ̖OɃ}b`.
+	WildPattern(const WildPattern&);		// don't copy
+	void operator=(const WildPattern&);		// don't assign
 
-	char* last_comma = strrchr(buf, ',');
-	if (last_comma) *last_comma = '\0';
-	strcat(buf, ")");
+	static bool piece_at(const Piece& piece, const char* name);
+public:
+	WildPattern(const char* wild);
 
-	return buf;
-}
+	~WildPattern() {
+		free(mText);
+		delete[] mPieces;
+	}
 
-const char* SectionCharacteristicsString(DWORD flags, char* buf=NULL)
+	/** name̓}b`邩? */
+	bool Match(const char* name) const;
+};
+
+WildPattern::WildPattern(const char* wild)
+	: mText(_strdup(wild)), mPieces(NULL), mCount(1), mAny(true)
 {
-	static char mybuf[20*32];
-	if (!buf) buf = mybuf;
-	sprintf(buf, "%08X(", flags);
+	for (char* p = mText; *p; ++p) {
+		*p = fold_char(*p);
+		if (*p == '*')
+			++mCount;
+		else
+			mAny = false;
+	}
+	mAny = mAny && mCount > 1;
+	mPieces = new Piece[mCount];
+	char* p = mText;
+	for (size_t i = 0; i < mCount; ++i) {
+		char* star = strchr(p, '*');
+		mPieces[i].text = p;
+		mPieces[i].len = star ? star - p : strlen(p);
+		p = star + 1;
+	}
+}
 
-	#define M(f, id)	if (flags & f) strcat(buf, id ", ")
-//	M(IMAGE_SCN_TYPE_REG,    "*reg");
-//	M(IMAGE_SCN_TYPE_DSECT,  "*dsect");
-//	M(IMAGE_SCN_TYPE_NOLOAD, "*noload");
-//	M(IMAGE_SCN_TYPE_GROUP,  "*group");
-	M(IMAGE_SCN_TYPE_NO_PAD, "*no pad");
-//	M(IMAGE_SCN_TYPE_COPY,   "*copy");
+bool WildPattern::piece_at(const Piece& piece, const char* name)
+{
+	for (size_t i = 0; i < piece.len; ++i) {
+		if (piece.text[i] != '?' && piece.text[i] != (char)fold_char(name[i]))
+			return false;
+	}
+	return true;
+}
 
-	M(IMAGE_SCN_CNT_CODE, "code");
-	M(IMAGE_SCN_CNT_INITIALIZED_DATA, "data");
-	M(IMAGE_SCN_CNT_UNINITIALIZED_DATA, "bss");
+bool WildPattern::Match(const char* name) const
+{
+	if (mAny)
+		return true;
+	size_t len = strlen(name);
+	const Piece& head = mPieces[0];
+	if (mCount == 1)
+		return len == head.len && piece_at(head, name);
 
-//	M(IMAGE_SCN_LNK_OTHER, "*other");
-	M(IMAGE_SCN_LNK_INFO,  "*info");
-//	M(IMAGE_SCN_TYPE_OVER, "*over");
-	M(IMAGE_SCN_LNK_COMDAT, "comdat");
+	// 擪Ɩ̒fЂ͈ʒu܂Ă. "*.dll" Ȃǂ͖̏ƍōς.
+	const Piece& tail = mPieces[mCount - 1];
+	if (len < head.len + tail.len || !piece_at(head, name) || !piece_at(tail, name + len - tail.len))
+		return false;
 
-	M(IMAGE_SCN_MEM_FARDATA,   "*fardata");
-	M(IMAGE_SCN_MEM_PURGEABLE, "*purgeable");
-	M(IMAGE_SCN_MEM_16BIT,     "*16bit");
-	M(IMAGE_SCN_MEM_LOCKED,    "*locked");
-	M(IMAGE_SCN_MEM_PRELOAD,   "*preload");
+	// Ԃ̒fЂ́AꂼłŌʒuɍ킹΂悢.
+	const char* p = name + head.len;
+	const char* end = name + len - tail.len;
+	for (size_t i = 1; i + 1 < mCount; ++i) {
+		const Piece& mid = mPieces[i];
+		for (;;) {
+			if ((size_t)(end - p) < mid.len)
+				return false;
+			if (piece_at(mid, p))
+				break;
+			++p;
+		}
+		p += mid.len;
+	}
+	return true;
+}
+//@}
 
-	M(IMAGE_SCN_ALIGN_1BYTES,   "1-byte align");
-	M(IMAGE_SCN_ALIGN_2BYTES,   "2-byte align");
-	M(IMAGE_SCN_ALIGN_4BYTES,   "4-byte align");
-	M(IMAGE_SCN_ALIGN_8BYTES,   "8-byte align");
-	M(IMAGE_SCN_ALIGN_16BYTES, "16-byte align");
-	M(IMAGE_SCN_ALIGN_32BYTES, "32-byte align");
-	M(IMAGE_SCN_ALIGN_64BYTES, "64-byte align");
+//------------------------------------------------------------------------
+/** ǂݎpŃ}bvt@C. */
+class MappedFile {
+#ifdef _WIN32
+	HANDLE mFile;
+	HANDLE mMapping;
+#endif
+	const uchar* mAddress;
+	size_t mSize;
+	MappedFile(const MappedFile&);		// don't copy
+	void operator=(const MappedFile&);	// don't assign
+public:
+	/** fname}bv. sIsLoaded()falseɂȂAGetLastError()ɗRc. */
+	MappedFile(const char* fname);
 
-	M(IMAGE_SCN_LNK_NRELOC_OVFL, "extended relocations");
-	M(IMAGE_SCN_MEM_DISCARDABLE, "discardable");
-	M(IMAGE_SCN_MEM_NOT_CACHED, "cannot be cached");
-	M(IMAGE_SCN_MEM_NOT_PAGED, "cannot be paged");
-	M(IMAGE_SCN_MEM_SHARED,  "shared");
-	M(IMAGE_SCN_MEM_EXECUTE, "execute");
-	M(IMAGE_SCN_MEM_READ,    "read");
-	M(IMAGE_SCN_MEM_WRITE,   "write");
-	#undef M
+	~MappedFile();
 
-	char* last_comma = strrchr(buf, ',');
-	if (last_comma) *last_comma = '\0';
-	strcat(buf, ")");
+	bool IsLoaded() const {
+		return mAddress != NULL;
+	}
+	const uchar* Address() const {
+		return mAddress;
+	}
+	size_t Size() const {
+		return mSize;
+	}
+};
 
-	return buf;
+#ifdef _WIN32
+MappedFile::MappedFile(const char* fname)
+	: mFile(INVALID_HANDLE_VALUE), mMapping(NULL), mAddress(NULL), mSize(0)
+{
+	mFile = ::CreateFile(fname, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (mFile == INVALID_HANDLE_VALUE)
+		return;
+	DWORD high = 0;
+	DWORD low = ::GetFileSize(mFile, &high);
+	if (high != 0 || low == 0) {	// 4GBȏƋt@C͈Ȃ.
+		::SetLastError(ERROR_BAD_FORMAT);
+		return;
+	}
+	mMapping = ::CreateFileMapping(mFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mMapping == NULL)
+		return;
+	mAddress = (const uchar*)::MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, low);
+	if (mAddress != NULL)
+		mSize = low;
 }
 
-const char* SubsystemString(WORD value, char* buf=NULL)
+MappedFile::~MappedFile()
 {
-	static char mybuf[100];
-	if (!buf) buf = mybuf;
-
-	// http://msdn.microsoft.com/en-us/library/ms680339(VS.85).aspx
-	// Subsystem
-	const char* id = "?";
-	switch (value) {
-	#define C(v, name)	case v: id = name
-	C(IMAGE_SUBSYSTEM_UNKNOWN,        "unknown");         break;		// Unknown subsystem.
-	C(IMAGE_SUBSYSTEM_NATIVE,         "native");          break; 		// No subsystem required (device drivers and native system processes).
-	C(IMAGE_SUBSYSTEM_WINDOWS_GUI,    "Windows GUI");     break;		// Windows graphical user interface (GUI) subsystem.
-	C(IMAGE_SUBSYSTEM_WINDOWS_CUI,    "Windows console"); break;		// Windows character-mode user interface (CUI) subsystem.
-	C(IMAGE_SUBSYSTEM_OS2_CUI,        "OS/2 console");    break;		// OS/2 CUI subsystem.
-	C(IMAGE_SUBSYSTEM_POSIX_CUI,      "POSIX console");   break;		// POSIX CUI subsystem.
-	C(IMAGE_SUBSYSTEM_NATIVE_WINDOWS, "native Win9x driver"); break;	// image is a native Win9x driver.
-	C(IMAGE_SUBSYSTEM_WINDOWS_CE_GUI, "Windows CE");      break;		// Windows CE system.
-	C(IMAGE_SUBSYSTEM_EFI_APPLICATION,         "Extensible Firmware Interface(EFI) application"); break;
-	C(IMAGE_SUBSYSTEM_EFI_BOOT_SERVICE_DRIVER, "Extensible Firmware Interface(EFI) driver with boot services"); break;
-	C(IMAGE_SUBSYSTEM_EFI_RUNTIME_DRIVER,      "Extensible Firmware Interface(EFI) driver with run-time services"); break;
-	C(IMAGE_SUBSYSTEM_EFI_ROM,                 "Extensible Firmware Interface(EFI) ROM image"); break;
-	C(IMAGE_SUBSYSTEM_XBOX,                    "Xbox system"); break;
-	C(IMAGE_SUBSYSTEM_WINDOWS_BOOT_APPLICATION,"Boot application"); break;
-	#undef C
+	if (mAddress != NULL)
+		::UnmapViewOfFile(mAddress);
+	if (mMapping != NULL)
+		::CloseHandle(mMapping);
+	if (mFile != INVALID_HANDLE_VALUE)
+		::CloseHandle(mFile);
+}
+#else
+MappedFile::MappedFile(const char* fname)
+	: mAddress(NULL), mSize(0)
+{
+	int fd = open(fname, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0 || (unsigned long long)st.st_size >= 0x100000000ULL) {
+		close(fd);
+		::SetLastError(ERROR_BAD_FORMAT);	// 4GBȏƋt@C͈Ȃ.
+		return;
 	}
-	sprintf(buf, "%04X(%s)", value, id);
-	return buf;
+	void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	int error = errno;
+	close(fd);		// }bv̓t@CĂL.
+	if (p == MAP_FAILED) {
+		::SetLastError(error);
+		return;
+	}
+	mAddress = (const uchar*)p;
+	mSize = (size_t)st.st_size;
 }
 
-const char* MachineString(WORD value, char* buf=NULL)
+MappedFile::~MappedFile()
 {
-	static char mybuf[100];
-	if (!buf) buf = mybuf;
+	if (mAddress != NULL)
+		munmap((void*)mAddress, mSize);
+}
+#endif
 
-	const char* id = "?";
-	switch (value) {
-	#define C(v, name)	case v: id = name
-	C(IMAGE_FILE_MACHINE_I386,   "32-bit Intel"); break;
-	C(IMAGE_FILE_MACHINE_IA64,   "64-bit Intel"); break;
-	C(IMAGE_FILE_MACHINE_AMD64,  "64-bit AMD"); break;
-	C(IMAGE_FILE_MACHINE_ALPHA,  "DEC Alpha"); break;
-	C(IMAGE_FILE_MACHINE_POWERPC,"Power PC"); break;
-	#undef C
+//------------------------------------------------------------------------
+///@name CRC32(ZIP/PNG݊)
+//@{
+/** CRC32vZ. crcɂ͏0Apɂ͑O̖߂ln. */
+ulong crc32(ulong crc, const uchar* p, size_t n)
+{
+	static ulong table[256];
+	if (table[1] == 0) {
+		for (ulong i = 0; i < 256; ++i) {
+			ulong c = i;
+			for (int k = 0; k < 8; ++k)
+				c = (c & 1) ? 0xEDB88320UL ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
 	}
-	sprintf(buf, "%04X(%s)", value, id);
-	return buf;
+	crc = ~crc & 0xFFFFFFFFUL;
+	while (n--)
+		crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	return ~crc & 0xFFFFFFFFUL;
 }
+//@}
 
-const char* TimeDateString(DWORD t, char* buf=NULL)
-{
-	static char mybuf[100];
-	if (!buf) buf = mybuf;
-	time_t timet = t;
+//------------------------------------------------------------------------
+/** deflate(RFC1951)`̐L.
+ * L̃TCYmłOŁAo͂ƂĂяõobt@g.
+ */
+class Inflater {
+	const uchar* mIn;
+	size_t mInLen;
+	size_t mInPos;
+	ulong mBitBuf;
+	int mBitCnt;
+	uchar* mOut;
+	size_t mOutLen;
+	size_t mOutPos;
+	bool mError;
 
-	char* s = ctime(&timet); if (!s) s = "? ";
-	sprintf(buf, "%08X(%.*s)", t, strlen(s)-1, s);	// ctime Ԃt͖ɉst̂ŁAő咷w肵Ĕ.
+	/** nt}\. Ƃ̌ƁAɕׂV{. */
+	struct Huffman {
+		short count[16];
+		short symbol[288];
+	};
 
-	return buf;
-}
+	int bits(int need);
+	int decode(const Huffman& h);
+	bool construct(Huffman& h, const short* length, int n);
+	bool stored();
+	bool codes(const Huffman& lencode, const Huffman& distcode);
+	bool fixed();
+	bool dynamic();
+public:
+	Inflater(const uchar* in, size_t inlen, uchar* out, size_t outlen)
+		: mIn(in), mInLen(inlen), mInPos(0), mBitBuf(0), mBitCnt(0),
+		  mOut(out), mOutLen(outlen), mOutPos(0), mError(false) {}
 
-#define PRINTLONG(f,m)		printf("%24s : %08X\n", #m, (f).m)
-#define PRINTWORD(f,m)		printf("%24s : %04X\n", #m, (f).m)
-#define PRINTVER(f,m)		printf("%24s : %d.%d\n", #m, (f).Major##m, (f).Minor##m)
-#define PRINTSTR(f,m)		printf("%24s : %s\n", #m, (f).m)
-#define PRINTSTRF(f,m,fn)	printf("%24s : %s\n", #m, fn((f).m))
+	/** SubNL. o͂傤outlenoCgŏIΐ. */
+	bool Run();
+};
 
-#define DIFFPRINTF(args)	(gQuiet ? (void)0 : (void)printf args)
-#define DIFFLONG(f,m)		if ((f##1).m != (f##2).m) { ++differ; DIFFPRINTF(("\n%s.%s:\n<%08X\n>%08X\n", prompt, #m, (f##1).m, (f##2).m)); }
-#define DIFFWORD(f,m)		if ((f##1).m != (f##2).m) { ++differ; DIFFPRINTF(("\n%s.%s:\n<%04X\n>%04X\n", prompt, #m, (f##1).m, (f##2).m)); }
-#define DIFFVER(f,m)		if ((f##1).Major##m != (f##2).Major##m || (f##1).Minor##m != (f##2).Minor##m) { ++differ; \
-								DIFFPRINTF(("\n%s.%s:\n<%d.%d\n>%d.%d\n", prompt, #m, \
-										(f##1).Major##m, (f##1).Minor##m, \
-										(f##2).Major##m, (f##2).Minor##m)); }
-#define DIFFSTR(f,m)		if (!strequ((f##1).m, (f##2).m)) { ++differ; DIFFPRINTF(("\n%s.%s:\n<%s\n>%s\n", prompt, #m, (f##1).m, (f##2).m)); }
-#define DIFFSTRF(f,m,fn)	if ((f##1).m != (f##2).m) { ++differ; DIFFPRINTF(("\n%s.%s:\n<%s\n", prompt, #m, fn((f##1).m))); DIFFPRINTF((">%s\n", fn((f##2).m))); }
+int Inflater::bits(int need)
+{
+	ulong val = mBitBuf;
+	while (mBitCnt < need) {
+		if (mInPos >= mInLen) {
+			mError = true;
+			return 0;
+		}
+		val |= (ulong)mIn[mInPos++] << mBitCnt;
+		mBitCnt += 8;
+	}
+	mBitBuf = val >> need;
+	mBitCnt -= need;
+	return (int)(val & ((1UL << need) - 1));
+}
 
-void dump_header(const IMAGE_FILE_HEADER& file)
+int Inflater::decode(const Huffman& h)
 {
-	PRINTSTRF(file, Machine, MachineString);
-	PRINTWORD(file, NumberOfSections);
-	PRINTSTRF(file, TimeDateStamp, TimeDateString);
-	PRINTLONG(file, PointerToSymbolTable);
-	PRINTLONG(file, NumberOfSymbols);
-	PRINTWORD(file, SizeOfOptionalHeader);
-	PRINTSTRF(file, Characteristics, ImageCharacteristicsString);
+	int code = 0, first = 0, index = 0;
+	for (int len = 1; len < 16; ++len) {
+		code |= bits(1);
+		if (mError)
+			return -1;
+		int count = h.count[len];
+		if (code - count < first)
+			return h.symbol[index + (code - first)];
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+	}
+	mError = true;
+	return -1;
 }
 
-int diff_header(const char* prompt, const IMAGE_FILE_HEADER& file1, const IMAGE_FILE_HEADER& file2)
+bool Inflater::construct(Huffman& h, const short* length, int n)
 {
-	int differ = 0;
-	DIFFSTRF(file, Machine, MachineString);
-	DIFFWORD(file, NumberOfSections);
-	if (!gIgnoreTimeStamp) { DIFFSTRF(file, TimeDateStamp, TimeDateString); }
-	DIFFLONG(file, PointerToSymbolTable);
-	DIFFLONG(file, NumberOfSymbols);
-	DIFFWORD(file, SizeOfOptionalHeader);
-	DIFFSTRF(file, Characteristics, ImageCharacteristicsString);
-	return differ;
+	memset(h.count, 0, sizeof(h.count));
+	for (int i = 0; i < n; ++i)
+		++h.count[length[i]];
+	if (h.count[0] == n)	// Ȃ. QƂdecode()G[ɂ.
+		return true;
+	int left = 1;
+	for (int len = 1; len < 16; ++len) {
+		left <<= 1;
+		left -= h.count[len];
+		if (left < 0)		// ߏȕ.
+			return false;
+	}
+	short offs[16];
+	offs[1] = 0;
+	for (int len = 1; len < 15; ++len)
+		offs[len + 1] = offs[len] + h.count[len];
+	for (int i = 0; i < n; ++i) {
+		if (length[i] != 0)
+			h.symbol[offs[length[i]]++] = (short)i;
+	}
+	return true;
 }
 
-void dump_header(const IMAGE_OPTIONAL_HEADER& opt)
+bool Inflater::stored()
 {
-	PRINTWORD(opt, Magic);
-	PRINTVER (opt, LinkerVersion);
-	PRINTLONG(opt, SizeOfCode);
+	mBitBuf = 0;	// oCgEɍ킹.
+	mBitCnt = 0;
+	if (mInPos + 4 > mInLen)
+		return false;
+	size_t len  = mIn[mInPos]     | (mIn[mInPos + 1] << 8);
+	size_t nlen = mIn[mInPos + 2] | (mIn[mInPos + 3] << 8);
+	mInPos += 4;
+	if (len != (~nlen & 0xFFFF) || mInPos + len > mInLen || mOutPos + len > mOutLen)
+		return false;
+	memcpy(mOut + mOutPos, mIn + mInPos, len);
+	mInPos += len;
+	mOutPos += len;
+	return true;
+}
+
+bool Inflater::codes(const Huffman& lencode, const Huffman& distcode)
+{
+	static const short lbase[29] = {
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static const short lext[29] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	static const short dbase[30] = {
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+		8193, 12289, 16385, 24577 };
+	static const short dext[30] = {
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	for (;;) {
+		int symbol = decode(lencode);
+		if (symbol < 0)
+			return false;
+		if (symbol < 256) {			// literal
+			if (mOutPos >= mOutLen)
+				return false;
+			mOut[mOutPos++] = (uchar)symbol;
+		}
+		else if (symbol == 256) {	// end of block
+			return true;
+		}
+		else {						// length/distance pair
+			symbol -= 257;
+			if (symbol >= 29)
+				return false;
+			size_t len = lbase[symbol] + bits(lext[symbol]);
+			symbol = decode(distcode);
+			if (symbol < 0 || symbol >= 30)
+				return false;
+			size_t dist = dbase[symbol] + bits(dext[symbol]);
+			if (mError || dist > mOutPos || mOutPos + len > mOutLen)
+				return false;
+			const uchar* from = mOut + mOutPos - dist;
+			while (len--)			// dȂ肪蓾̂1oCgʂ.
+				mOut[mOutPos++] = *from++;
+		}
+	}
+}
+
+bool Inflater::fixed()
+{
+	static Huffman lencode, distcode;
+	static bool built = false;
+	if (!built) {
+		short length[288];
+		int i;
+		for (i = 0;   i < 144; ++i) length[i] = 8;
+		for (;        i < 256; ++i) length[i] = 9;
+		for (;        i < 280; ++i) length[i] = 7;
+		for (;        i < 288; ++i) length[i] = 8;
+		construct(lencode, length, 288);
+		for (i = 0;   i < 30;  ++i) length[i] = 5;
+		construct(distcode, length, 30);
+		built = true;
+	}
+	return codes(lencode, distcode);
+}
+
+bool Inflater::dynamic()
+{
+	static const short order[19] = {
+		16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+	int nlen  = bits(5) + 257;
+	int ndist = bits(5) + 1;
+	int ncode = bits(4) + 4;
+	if (mError || nlen > 286 || ndist > 30)
+		return false;
+
+	short length[288 + 32];
+	int index;
+	for (index = 0; index < ncode; ++index)
+		length[order[index]] = (short)bits(3);
+	for (; index < 19; ++index)
+		length[order[index]] = 0;
+	Huffman lencode, distcode;
+	if (mError || !construct(lencode, length, 19))
+		return false;
+
+	index = 0;
+	while (index < nlen + ndist) {
+		int symbol = decode(lencode);
+		if (symbol < 0)
+			return false;
+		if (symbol < 16) {
+			length[index++] = (short)symbol;
+			continue;
+		}
+		short len = 0;
+		if (symbol == 16) {
+			if (index == 0)
+				return false;
+			len = length[index - 1];
+			symbol = 3 + bits(2);
+		}
+		else if (symbol == 17)
+			symbol = 3 + bits(3);
+		else
+			symbol = 11 + bits(7);
+		if (mError || index + symbol > nlen + ndist)
+			return false;
+		while (symbol--)
+			length[index++] = len;
+	}
+	if (length[256] == 0)	// end of block .
+		return false;
+	if (!construct(lencode, length, nlen) || !construct(distcode, length + nlen, ndist))
+		return false;
+	return codes(lencode, distcode);
+}
+
+bool Inflater::Run()
+{
+	int last;
+	do {
+		last = bits(1);
+		bool ok;
+		switch (bits(2)) {
+		case 0:  ok = stored();  break;
+		case 1:  ok = fixed();   break;
+		case 2:  ok = dynamic(); break;
+		default: ok = false;     break;
+		}
+		if (!ok || mError)
+			return false;
+	} while (!last);
+	return mOutPos == mOutLen;
+}
+
+//------------------------------------------------------------------------
+/** ZIP. fBNgǂ݁Ao[͗vɐL. */
+class ZipArchive {
+public:
+	enum {
+		MAX_MEMBER_SIZE = 0x7FFFFFFF,	///< LTCY̏. PEt@C2GBzȂ.
+		MAX_DEFLATE_RATIO = 1032,		///< deflate ̈k̏. 258oCg̈vŒZ̕ŌJԂꍇ.
+	};
+
+	/** fBNg̃Gg. */
+	struct Member {
+		const char* name;	///< ɓpX. e.g. "bin/sample.dll"
+		ulong crc;			///< Lf[^CRC32.
+		ulong compsize;		///< kTCY.
+		ulong size;			///< LTCY.
+		ulong offset;		///< [Jwb_̈ʒu.
+		WORD method;		///< 0:stored, 8:deflated.
+
+		/** tH_̃Gg? */
+		bool IsFolder() const {
+			size_t n = strlen(name);
+			return n == 0 || name[n - 1] == '/';
+		}
+	};
+private:
+	MappedFile mFile;
+	char* mPath;
+	Member* mMembers;
+	char* mNames;
+	size_t mCount;
+	NameIndex mIndex;		///< o[ mMembers ̓Y.
+	bool mLoaded;
+	size_t mRefs;			///< OpenArchive  CloseArchive ĂȂ.
+	bool mCached;			///< OpenArchive ̃LbVɂ. ΎgIɎ̂Ă.
+	ZipArchive(const ZipArchive&);		// don't copy
+	void operator=(const ZipArchive&);	// don't assign
+
+	bool load();
+	friend const ZipArchive* OpenArchive(const char* fname);
+	friend void CloseArchive(const ZipArchive* zip);
+public:
+	ZipArchive(const char* fname);
+
+	~ZipArchive();
+
+	bool IsLoaded() const {
+		return mLoaded;
+	}
+	const char* Path() const {
+		return mPath;
+	}
+	size_t Count() const {
+		return mCount;
+	}
+	const Member& operator[](size_t i) const {
+		return mMembers[i];
+	}
+
+	/** ɓpXŃo[T. 啶͖. NULL. */
+	const Member* Find(const char* name) const;
+
+	/** fBNgɂLTCYL蓾̂? MpłȂlȂ̂ŁAmۂOɊm߂.
+	 * kȂ爳kTCYƓAdeflate Ȃ爳k̏(1032{)ȓŁA MAX_MEMBER_SIZE ȉł邱.
+	 */
+	bool IsPlausible(const Member& m) const;
+
+	/** o[bufɐL. bufm.sizeoCgȏKv. CRC32؂. */
+	bool Extract(const Member& m, uchar* buf) const;
+};
+
+/** gGfBA16bitlǂ. */
+inline WORD get16(const uchar* p)
+{
+	return (WORD)(p[0] | (p[1] << 8));
+}
+
+/** gGfBA32bitlǂ. */
+inline ulong get32(const uchar* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((ulong)p[3] << 24);
+}
+
+ZipArchive::ZipArchive(const char* fname)
+	: mFile(fname), mPath(NULL), mMembers(NULL), mNames(NULL), mCount(0), mLoaded(false), mRefs(0), mCached(false)
+{
+	mPath = _strdup(fname);
+	if (mFile.IsLoaded()) {
+		mLoaded = load();
+		if (!mLoaded)
+			::SetLastError(ERROR_BAD_FORMAT);
+	}
+	for (size_t i = 0; i < mCount; ++i)
+		mIndex.Add(mMembers[i].name, i);
+}
+
+ZipArchive::~ZipArchive()
+{
+	delete[] mMembers;
+	delete[] mNames;
+	free(mPath);
+}
+
+bool ZipArchive::load()
+{
+	const uchar* base = mFile.Address();
+	const size_t size = mFile.Size();
+	if (size < 22)
+		return false;
+
+	// Rg(ő64KB)zāAend of central directory T.
+	const uchar* eocd = NULL;
+	size_t lower = size > 22 + 0xFFFF ? size - 22 - 0xFFFF : 0;
+	for (size_t i = size - 22 + 1; i-- > lower; ) {
+		if (get32(base + i) == 0x06054B50) {
+			eocd = base + i;
+			break;
+		}
+	}
+	if (eocd == NULL)
+		return false;
+	size_t count  = get16(eocd + 10);
+	ulong cdsize   = get32(eocd + 12);
+	ulong cdoffset = get32(eocd + 16);
+	if (cdoffset > size || cdsize > size - cdoffset)	// ZIP64͖Ή.
+		return false;
+
+	mMembers = new Member[count];
+	mNames = new char[cdsize + count];	// eONULI[tĂ܂.
+	char* name = mNames;
+	const uchar* p = base + cdoffset;
+	const uchar* end = p + cdsize;
+	for (mCount = 0; mCount < count; ++mCount) {
+		if (p + 46 > end || get32(p) != 0x02014B50)
+			return false;
+		size_t namelen = get16(p + 28);
+		size_t skip = 46 + namelen + get16(p + 30) + get16(p + 32);
+		if (p + skip > end)
+			return false;
+		Member& m = mMembers[mCount];
+		m.method   = get16(p + 10);
+		m.crc      = get32(p + 16);
+		m.compsize = get32(p + 20);
+		m.size     = get32(p + 24);
+		m.offset   = get32(p + 42);
+		memcpy(name, p + 46, namelen);
+		name[namelen] = '\0';
+		m.name = name;
+		name += namelen + 1;
+		p += skip;
+	}
+	return true;
+}
+
+const ZipArchive::Member* ZipArchive::Find(const char* name) const
+{
+	size_t i;
+	return mIndex.Find(name, &i) ? &mMembers[i] : NULL;
+}
+
+bool ZipArchive::IsPlausible(const Member& m) const
+{
+	if (m.size > MAX_MEMBER_SIZE || m.compsize > mFile.Size())
+		return false;
+	if (m.method == 8)
+		return m.size / MAX_DEFLATE_RATIO <= m.compsize;
+	return m.size == m.compsize;
+}
+
+bool ZipArchive::Extract(const Member& m, uchar* buf) const
+{
+	const uchar* base = mFile.Address();
+	const size_t size = mFile.Size();
+	if (m.offset > size || size - m.offset < 30 || get32(base + m.offset) != 0x04034B50)
+		return false;
+	size_t data = m.offset + 30 + get16(base + m.offset + 26) + get16(base + m.offset + 28);
+	if (data > size || size - data < m.compsize)
+		return false;
+
+	const uchar* src = base + data;
+	if (m.method == 0) {
+		if (m.compsize != m.size)
+			return false;
+		memcpy(buf, src, m.size);
+	}
+	else if (m.method == 8) {
+		Inflater inflater(src, m.compsize, buf, m.size);
+		if (!inflater.Run())
+			return false;
+	}
+	else {
+		return false;		// Ή̈k`.
+	}
+	return crc32(0, buf, m.size) == m.crc;
+}
+
+//------------------------------------------------------------------------
+///@name ZIPɂ͎̓w
+//@{
+/** ZIPɂ̃t@C? (gq .zip ̊t@C) */
+bool IsArchive(const char* fname)
+{
+	const char* ext = strrchr(fname, '.');
+	return ext != NULL && striequ(ext, ".zip") && IsExistFile(fname);
+}
+
+/** "ARCHIVE.zip!MEMBER" `̃pXAɖƃo[ɕ.
+ * @param spec		͂pX.
+ * @param archive	ɖ̊i[. _MAX_PATH oCgȏ.
+ * @return o[. spec Ƀo[włȂNULL.
+ */
+const char* separate_archive_member(const char* spec, char* archive)
+{
+	for (const char* bang = strchr(spec, '!'); bang != NULL; bang = strchr(bang + 1, '!')) {
+		size_t n = bang - spec;
+		if (n >= _MAX_PATH)
+			break;
+		memcpy(archive, spec, n);
+		archive[n] = '\0';
+		if (IsArchive(archive))
+			return bang + 1;
+	}
+	return NULL;
+}
+
+/** ɂJ. fBNgrœɂJԂJȂ悤A߂2ێ.
+ * 풓[hł͕ێɏɂꂤ̂ŁAĂJ.
+ * gI CloseArchive 邱. ܂ł́ALbVOĂ̂ĂȂ.
+ * @return J. sNULLԂAGetLastError()ɗRc.
+ */
+const ZipArchive* OpenArchive(const char* fname)
+{
+	static ZipArchive* cache[2];
+	static FileStamp stamps[2];
+	static size_t next;
+	FileStamp stamp = { 0, 0 };
+	get_file_stamp(fname, stamp);
+	size_t slot = next;
+	bool found = false;
+	for (size_t i = 0; i < 2; ++i) {
+		if (cache[i] != NULL && strequ(cache[i]->Path(), fname)) {
+			if (stamps[i] == stamp) {
+				++cache[i]->mRefs;
+				return cache[i];
+			}
+			slot = i;
+			found = true;
+			break;
+		}
+	}
+	// gpłȂ΁AƓւ.
+	if (!found && cache[slot] != NULL && cache[slot]->mRefs != 0
+		&& (cache[1 - slot] == NULL || cache[1 - slot]->mRefs == 0))
+		slot = 1 - slot;
+	ZipArchive* zip = new ZipArchive(fname);
+	if (!zip->IsLoaded()) {
+		DWORD win32error = ::GetLastError();
+		delete zip;
+		::SetLastError(win32error);
+		return NULL;
+	}
+	if (cache[slot] != NULL) {
+		cache[slot]->mCached = false;
+		if (cache[slot]->mRefs == 0)
+			delete cache[slot];		// gpȂ CloseArchive Ŏ̂Ă.
+	}
+	cache[slot] = zip;
+	stamps[slot] = stamp;
+	zip->mCached = true;
+	zip->mRefs = 1;
+	next = (slot + 1) % 2;
+	return zip;
+}
+
+/** OpenArchive œɂ̎gpI. NULLȂ牽Ȃ. */
+void CloseArchive(const ZipArchive* zip)
+{
+	ZipArchive* z = const_cast<ZipArchive*>(zip);
+	if (z != NULL && --z->mRefs == 0 && !z->mCached)
+		delete z;
+}
+
+/** Ƀo[w. Ƀo[włȂA܂͌ȂNULL.
+ * ΏɂJ܂zipɕԂ̂ŁAo[gI CloseArchive(zip) 邱.
+ * ȂzipNULLƂȂ.
+ */
+const ZipArchive::Member* FindArchiveMember(const char* spec, const ZipArchive*& zip)
+{
+	zip = NULL;
+	char archive[_MAX_PATH];
+	const char* name = separate_archive_member(spec, archive);
+	if (name == NULL)
+		return NULL;
+	const ZipArchive* z = OpenArchive(archive);
+	if (z == NULL)
+		return NULL;
+	const ZipArchive::Member* m = z->Find(name);
+	if (m == NULL) {
+		CloseArchive(z);
+		::SetLastError(ERROR_FILE_NOT_FOUND);
+		return NULL;
+	}
+	zip = z;
+	return m;
+}
+
+//@}
+
+//------------------------------------------------------------------------
+/** ȌW. GNX|[g/C|[g̔rɎg.
+ * ̓`NPʂŊmۂAǉĂ͈̕ړȂ.
+ */
+class NameSet {
+	enum { CHUNK_SIZE = 64*1024 };
+	char* mChunk;		///< 擪Ƀ|C^1̑O`Nւ̃N.
+	size_t mChunkUsed;
+	size_t mChunkSize;
+	const char** mNames;
+	size_t mCount;
+	size_t mCapacity;
+	NameSet(const NameSet&);		// don't copy
+	void operator=(const NameSet&);	// don't assign
+
+	char* alloc(size_t n);
+public:
+	NameSet() : mChunk(NULL), mChunkUsed(0), mChunkSize(0), mNames(NULL), mCount(0), mCapacity(0) {}
+
+	~NameSet();
+
+	/** 𕡎ʂĒǉ. */
+	void Add(const char* s);
+
+	/** ʂɒǉ. s͏W蒷邱. */
+	void AddRef(const char* s);
+
+	/** NULI[l߂ĕׂ̈悩Aʂɒǉ. */
+	void AddPacked(const char* p, size_t size);
+
+	/** ɕׁAd. */
+	void Sort();
+
+	/** NULI[l߂ĕׂƂ̃oCg. */
+	size_t PackedSize() const;
+
+	size_t Count() const {
+		return mCount;
+	}
+	const char* operator[](size_t i) const {
+		return mNames[i];
+	}
+};
+
+NameSet::~NameSet()
+{
+	while (mChunk != NULL) {
+		char* prev = *(char**)mChunk;
+		free(mChunk);
+		mChunk = prev;
+	}
+	free(mNames);
+}
+
+char* NameSet::alloc(size_t n)
+{
+	if (mChunk == NULL || mChunkUsed + n > mChunkSize) {
+		size_t size = sizeof(char*) + max(n, (size_t)CHUNK_SIZE);
+		char* chunk = (char*)malloc(size);
+		if (chunk == NULL)
+			error_abort("out of memory\n");
+		*(char**)chunk = mChunk;
+		mChunk = chunk;
+		mChunkUsed = sizeof(char*);
+		mChunkSize = size;
+	}
+	char* p = mChunk + mChunkUsed;
+	mChunkUsed += n;
+	return p;
+}
+
+void NameSet::Add(const char* s)
+{
+	size_t n = strlen(s) + 1;
+	char* p = alloc(n);
+	memcpy(p, s, n);
+	AddRef(p);
+}
+
+void NameSet::AddRef(const char* s)
+{
+	if (mCount == mCapacity) {
+		mCapacity = mCapacity ? mCapacity * 2 : 256;
+		mNames = (const char**)realloc(mNames, mCapacity * sizeof(const char*));
+		if (mNames == NULL)
+			error_abort("out of memory\n");
+	}
+	mNames[mCount++] = s;
+}
+
+void NameSet::AddPacked(const char* p, size_t size)
+{
+	const char* end = p + size;
+	while (p < end) {
+		AddRef(p);
+		p += strlen(p) + 1;
+	}
+}
+
+int compare_names(const void* a, const void* b)
+{
+	return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+void NameSet::Sort()
+{
+	if (mCount == 0)
+		return;
+	qsort(mNames, mCount, sizeof(const char*), compare_names);
+	size_t n = 1;
+	for (size_t i = 1; i < mCount; ++i) {
+		if (!strequ(mNames[i], mNames[n - 1]))
+			mNames[n++] = mNames[i];
+	}
+	mCount = n;
+}
+
+size_t NameSet::PackedSize() const
+{
+	size_t size = 0;
+	for (size_t i = 0; i < mCount; ++i)
+		size += strlen(mNames[i]) + 1;
+	return size;
+}
+
+//------------------------------------------------------------------------
+/** tH_̃t@C(tH_͏)ŁAwildɃ}b`̖̂O namesɉ.
+ * т͗񋓏̂܂. Linuxł getdents64 ő傫ȒPʂł܂Ƃ߂ēǂ݁A
+ * ʂȂڂ fstatat Œׂ. ǂݍݗp̗̈͌ĂяoɊmۂ̂ōēł.
+ * @return Ȃtrue. sGetLastError()ɗRc.
+ */
+bool ListFolder(const char* dir, const char* wild, NameSet& names)
+{
+#ifdef __linux__
+	struct dirent64_record {
+		unsigned long long d_ino;
+		long long d_off;
+		unsigned short d_reclen;
+		unsigned char d_type;
+		char d_name[1];
+	};
+	WildPattern pattern(wild);
+	int fd = openat(AT_FDCWD, dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0) {
+		::SetLastError(errno);
+		return false;
+	}
+	const size_t BUF_SIZE = 64*1024;
+	char* buf = new char[BUF_SIZE];
+	long n;
+	while ((n = syscall(SYS_getdents64, fd, buf, BUF_SIZE)) > 0) {
+		for (long pos = 0; pos < n; ) {
+			const dirent64_record* d = (const dirent64_record*)(buf + pos);
+			pos += d->d_reclen;
+			bool file = d->d_type == DT_REG;
+			if (d->d_type == DT_LNK || d->d_type == DT_UNKNOWN) {
+				struct stat st;
+				file = fstatat(fd, d->d_name, &st, 0) == 0 && S_ISREG(st.st_mode);
+			}
+			if (file && pattern.Match(d->d_name))
+				names.Add(d->d_name);
+		}
+	}
+	int error = errno;
+	close(fd);
+	delete[] buf;
+	if (n < 0) {
+		::SetLastError(error);
+		return false;
+	}
+	return true;
+#else
+	FindFile find;
+	for (find.Open(dir, wild); find; find.Next()) {
+		if (find.IsFolder())
+			continue;
+		names.Add(find.name);
+	}//.endfor
+	return true;
+#endif
+}
+
+//------------------------------------------------------------------------
+///@name XibvVbg`
+/// [Xς݃oCĩwb_AZNV\AZNVf[^̃ubNnbVA
+/// GNX|[g/C|[gL^t@C. ̃oCi FILE1 ƂĔrł.
+/// Ŝ}bvĂ̂܂܎QƂł悤AŒ蒷R[hƑ΃ItZbgō\.
+/// l͑SăgGfBA.
+//@{
+/** XibvVbg`̔. ̖݊ύXグ. */
+const DWORD SNAPSHOT_VERSION = 1;
+
+/** XibvVbg̃t@Cwb_. t@C擪ɒu. */
+struct SnapshotHeader {
+	char  Magic[8];			///< "EXDFSNAP"
+	DWORD Version;			///< SNAPSHOT_VERSION
+	DWORD BlockSize;		///< ubNnbV̒PʃoCg.
+	DWORD FileSize;			///< t@C̃TCY.
+	DWORD FileCrc;			///< t@CŜCRC32.
+	DWORD HeadersOffset;	///< t@C擪ZNV\܂ł̈̕ʒu.
+	DWORD HeadersSize;		///< ̃̕TCY.
+	DWORD SectionsOffset;	///< SnapshotSection[NumberOfSections] ̈ʒu.
+	DWORD ExportsOffset;	///< GNX|[g(, NULI[̕)̈ʒu.
+	DWORD ExportsSize;		///< ̃oCg.
+	DWORD ImportsOffset;	///< C|[g("DLL!֐" or "DLL!#")̈ʒu.
+	DWORD ImportsSize;		///< ̃oCg.
+	DWORD Reserved;			///< 0. 8oCgEɑ邽.
+};
+
+/** ZNVƂ̃ubNnbV\̈ʒu. */
+struct SnapshotSection {
+	DWORD HashOffset;		///< DWORD[BlockCount] CRC32\̈ʒu.
+	DWORD BlockCount;		///< size_of_rawdata BlockSizeŐ؂グubN.
+};
+
+const char SNAPSHOT_MAGIC[8] = { 'E', 'X', 'D', 'F', 'S', 'N', 'A', 'P' };
+
+/** XibvVbgt@C? 擪̃}WbNm߂. */
+bool IsSnapshotFile(const char* fname)
+{
+	DWORD win32error = ::GetLastError();	// ĂяõG[󂳂Ȃ.
+	char magic[sizeof(SNAPSHOT_MAGIC)];
+	bool ret = false;
+	FILE* fp = fopen(fname, "rb");
+	if (fp != NULL) {
+		ret = fread(magic, sizeof(magic), 1, fp) == 1 && memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0;
+		fclose(fp);
+	}
+	::SetLastError(win32error);
+	return ret;
+}
+//@}
+
+//------------------------------------------------------------------------
+/** ͈͌ς݂̃oCg.
+ * t@CǂݍݎɈxAr[vł͂ȏ͈̔͌Ȃ.
+ */
+struct Span {
+	const uchar* data;	///< 擪. ȂNULLł悢.
+	size_t size;		///< oCg.
+};
+
+/** ZNVԂ. Name8傤ǂNULI[Ȃ̂ŁAI[ʂ. */
+const char* SectionNameString(const BYTE* name, char* buf=NULL)
+{
+	static char mybuf[IMAGE_SIZEOF_SHORT_NAME + 1];
+	if (!buf) buf = mybuf;
+	memcpy(buf, name, IMAGE_SIZEOF_SHORT_NAME);
+	buf[IMAGE_SIZEOF_SHORT_NAME] = '\0';
+	return buf;
+}
+
+/** ZNVf[^̂ArΏۂƂoCg. */
+DWORD size_of_rawdata(const IMAGE_SECTION_HEADER& sec)
+{
+	return min(sec.Misc.VirtualSize, sec.SizeOfRawData);
+}
+
+/** PE format file image */
+class ExeFileImage : public LOADED_IMAGE {
+	BOOL mLoaded;
+	uchar* mBuffer;		///< ɂLC[W. MapAndLoadœǂ񂾏ꍇNULL.
+	MappedFile* mSnapshotFile;			///< XibvVbgǂ񂾏ꍇ̃}bv. ȊONULL.
+	const SnapshotHeader* mSnapshot;	///< XibvVbg̃wb_. ȊONULL.
+	ExeFileImage(const ExeFileImage&);		// don't copy
+	void operator=(const ExeFileImage&);	// don't assign
+
+	Span* mRawData;		///< ZNVƂ͈̔͌ς݃f[^. XibvVbgł͋.
+	Span mDirectories[IMAGE_NUMBEROF_DIRECTORY_ENTRIES];	///< ͈͌ς݂̃f[^fBNg. sȂ̂͋.
+
+	BOOL attach(const char* name, uchar* image, size_t size);
+	BOOL loadArchiveMember(const char* spec);
+	BOOL loadSnapshot(const char* fname);
+	BOOL validate();
+	void validateOrUnload();
+	void unload();
+	const SnapshotSection& snapshotSection(size_t sec) const {
+		return ((const SnapshotSection*)((const uchar*)mSnapshot + mSnapshot->SectionsOffset))[sec];
+	}
+public:
+	/** fnameǂݍ. "ARCHIVE.zip!MEMBER" `Ȃ珑Ƀo[ɐL.
+	 * PEt@CłȂXibvVbgł΁Aǂݍ.
+	 */
+	ExeFileImage(const char* fname);
+
+	/** ̃t@CC[W𕡎ʂēǂݍ. name͕\p. */
+	ExeFileImage(const char* name, const uchar* image, size_t size);
+
+	~ExeFileImage();
+
+	/** \p̖O ModuleName tւ. t@Cʂ̒Ԃ̃pXŊJꍇɎg. */
+	void Rename(const char* name);
+
+	void print() const;
+
+	bool IsLoaded() const {
+		return mLoaded == TRUE;
+	}
+
+	/** XibvVbgǂݍ񂾂? ̏ꍇZNVf[^͖AubNnbV. */
+	bool IsSnapshot() const {
+		return mSnapshot != NULL;
+	}
+
+	/** ̃XibvVbǧt@CfilȇŜv邩?
+	 * L^t@C̃TCYCRC32Ŕ肷. XibvVbgłȂfalse.
+	 */
+	bool MatchesSnapshot(const ExeFileImage& file) const;
+
+	/** t@CŜ̃TCY. XibvVbgȂ猳t@C̃TCY. */
+	size_t FileSize() const {
+		return mSnapshot ? mSnapshot->FileSize : SizeOfImage;
+	}
+
+	/** t@CŜCRC32. XibvVbgȂL^l. */
+	ulong FileCrc() const {
+		return mSnapshot ? mSnapshot->FileCrc : crc32(0, MappedAddress, SizeOfImage);
+	}
+
+	/** ZNVsec̔rΏۃf[^. t@Cz镔͐؂l߂Ă.
+	 * XibvVbgłdataNULLŁAsizeL.
+	 */
+	const Span& RawData(size_t sec) const {
+		return mRawData[sec];
+	}
+
+	/** f[^fBNgindex̓e. ͈͊OsȂ. */
+	const Span& Directory(size_t index) const {
+		return mDirectories[index];
+	}
+
+	/** Lȃf[^fBNg̐. NumberOfRvaAndSizes zƃIvViwb_̑傫Ől. */
+	size_t NumberOfDirectories() const;
+
+	/** ubNnbV̒PʃoCg. XibvVbgłȂ gSnapshotBlockSize. */
+	size_t BlockSize() const {
+		return mSnapshot ? mSnapshot->BlockSize : gSnapshotBlockSize;
+	}
+
+	/** ZNVsec [offset, offset+len) ̃ubNnbV. XibvVbgȂL^lAłȂΌvZ.
+	 * offsetBlockSize()̔{ŁAlen͂̃ubN̒ł邱.
+	 */
+	ulong BlockHash(size_t sec, size_t offset, size_t len) const;
+
+	/** RVAt@CC[W̃|C^ɕϊ. [rva, rva+size) ZNVf[^Ɏ܂ȂNULL.
+	 * @param avail	rvaZNVf[^܂ł̃oCg̊i[(svȂNULL).
+	 */
+	const uchar* RvaToPtr(DWORD rva, size_t size, size_t* avail = NULL) const;
+
+	/** RVAɂNULI[. ZNVf[^Ɏ܂ȂNULL. */
+	const char* RvaToString(DWORD rva) const;
+
+	/** GNX|[g̏W𓾂. */
+	void GetExports(NameSet& names) const;
+
+	/** C|[g̏W𓾂. vf "DLL!֐" ܂ "DLL!#". */
+	void GetImports(NameSet& names) const;
+
+	/** XibvVbgfnameɏo. serrnoɗRc. */
+	bool WriteSnapshot(const char* fname) const;
+};
+
+ExeFileImage::ExeFileImage(const char* fname)
+	: mLoaded(FALSE), mBuffer(NULL), mSnapshotFile(NULL), mSnapshot(NULL), mRawData(NULL)
+{
+	char archive[_MAX_PATH];
+	if (separate_archive_member(fname, archive) != NULL)
+		mLoaded = loadArchiveMember(fname);
+	else {
+		mLoaded = ::MapAndLoad(const_cast<char*>(fname), ".", this, TRUE, TRUE);
+		if (!mLoaded && IsSnapshotFile(fname))
+			mLoaded = loadSnapshot(fname);
+	}
+	validateOrUnload();
+}
+
+ExeFileImage::ExeFileImage(const char* name, const uchar* image, size_t size)
+	: mLoaded(FALSE), mBuffer(NULL), mSnapshotFile(NULL), mSnapshot(NULL), mRawData(NULL)
+{
+	LOADED_IMAGE* li = this;
+	memset(li, 0, sizeof(*li));
+	mBuffer = (uchar*)malloc(size + 1);	// C[WłNULLɂȂ.
+	if (mBuffer == NULL) {
+		::SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return;
+	}
+	memcpy(mBuffer, image, size);
+	mLoaded = attach(name, mBuffer, size);
+	validateOrUnload();
+}
+
+/** ǂݍ߂Ă validate() sAsǂݍ݂. */
+void ExeFileImage::validateOrUnload()
+{
+	if (mLoaded && !validate()) {
+		DWORD win32error = ::GetLastError();
+		unload();
+		::SetLastError(win32error);
+	}
+}
+
+ExeFileImage::~ExeFileImage()
+{
+	unload();
+}
+
+void ExeFileImage::unload()
+{
+	delete[] mRawData;
+	if (mBuffer != NULL || mSnapshotFile != NULL) {
+		free(ModuleName);
+		free(mBuffer);
+		delete mSnapshotFile;
+	}
+	else if (mLoaded)
+		::UnMapAndLoad(this);
+	mLoaded = FALSE;
+	mBuffer = NULL;
+	mSnapshotFile = NULL;
+	mSnapshot = NULL;
+	mRawData = NULL;
+}
+
+void ExeFileImage::Rename(const char* name)
+{
+#ifdef _WIN32
+	if (mBuffer == NULL && mSnapshotFile == NULL)
+		return;		// MapAndLoad ݒ肵 ModuleName  imagehlp .
+#endif
+	if (!mLoaded || strequ(ModuleName, name))
+		return;
+	free(ModuleName);
+	ModuleName = _strdup(name);
+}
+
+/** ̃t@CC[Wimageɑ΂āAMapAndLoad Ɠl LOADED_IMAGE ݒ肷. */
+BOOL ExeFileImage::attach(const char* name, uchar* image, size_t size)
+{
+	// ImageNtHeader ͔͈͌Ȃ̂ŁAɃwb_܂Ă邱Ƃm߂.
+	const IMAGE_DOS_HEADER* dos = (const IMAGE_DOS_HEADER*)image;
+	if (size < sizeof(IMAGE_DOS_HEADER) || dos->e_magic != IMAGE_DOS_SIGNATURE
+		|| dos->e_lfanew < 0 || (ulong)dos->e_lfanew + sizeof(IMAGE_NT_HEADERS) > size) {
+		::SetLastError(ERROR_BAD_FORMAT);
+		return FALSE;
+	}
+	PIMAGE_NT_HEADERS nt = ::ImageNtHeader(image);
+	if (nt == NULL || (uchar*)(IMAGE_FIRST_SECTION(nt) + nt->FileHeader.NumberOfSections) > image + size) {
+		::SetLastError(ERROR_BAD_FORMAT);
+		return FALSE;
+	}
+	ModuleName       = _strdup(name);
+	hFile            = INVALID_HANDLE_VALUE;
+	MappedAddress    = image;
+	FileHeader       = nt;
+	NumberOfSections = nt->FileHeader.NumberOfSections;
+	Sections         = IMAGE_FIRST_SECTION(nt);
+	Characteristics  = nt->FileHeader.Characteristics;
+	fReadOnly        = TRUE;
+	SizeOfImage      = (ULONG)size;
+	return TRUE;
+}
+
+/** Ƀo[LAMapAndLoad Ɠl LOADED_IMAGE ݒ肷. */
+BOOL ExeFileImage::loadArchiveMember(const char* spec)
+{
+	LOADED_IMAGE* image = this;
+	memset(image, 0, sizeof(*image));
+
+	const ZipArchive* zip;
+	const ZipArchive::Member* m = FindArchiveMember(spec, zip);
+	if (m == NULL)
+		return FALSE;
+	// LTCYL蓾ȂAmۂłȂ΁ALłȂꂽɂƓƂ.
+	const size_t size = m->size;
+	if (zip->IsPlausible(*m))
+		mBuffer = (uchar*)malloc(size + 1);	// 󃁃o[łNULLɂȂ.
+	const bool extracted = mBuffer != NULL && zip->Extract(*m, mBuffer);
+	CloseArchive(zip);
+	if (!extracted) {
+		::SetLastError(ERROR_INVALID_DATA);
+		return FALSE;
+	}
+	return attach(spec, mBuffer, size);
+}
+
+/** XibvVbg}bvAL^wb_ɑ΂ LOADED_IMAGE ݒ肷. */
+BOOL ExeFileImage::loadSnapshot(const char* fname)
+{
+	LOADED_IMAGE* image = this;
+	memset(image, 0, sizeof(*image));
+
+	mSnapshotFile = new MappedFile(fname);
+	if (!mSnapshotFile->IsLoaded())
+		return FALSE;
+	const uchar* base = mSnapshotFile->Address();
+	const size_t size = mSnapshotFile->Size();
+	const SnapshotHeader* h = (const SnapshotHeader*)base;
+	#define IN_FILE(offset, len)	((offset) <= size && (len) <= size - (offset))
+	if (size < sizeof(SnapshotHeader) || memcmp(h->Magic, SNAPSHOT_MAGIC, sizeof(h->Magic)) != 0
+		|| h->Version != SNAPSHOT_VERSION || h->BlockSize == 0
+		|| !IN_FILE(h->HeadersOffset, h->HeadersSize)
+		|| !IN_FILE(h->ExportsOffset, h->ExportsSize) || !IN_FILE(h->ImportsOffset, h->ImportsSize)
+		|| (h->ExportsSize != 0 && base[h->ExportsOffset + h->ExportsSize - 1] != '\0')
+		|| (h->ImportsSize != 0 && base[h->ImportsOffset + h->ImportsSize - 1] != '\0')) {
+		::SetLastError(ERROR_BAD_FORMAT);
+		return FALSE;
+	}
+	if (!attach(fname, const_cast<uchar*>(base + h->HeadersOffset), h->HeadersSize))
+		return FALSE;
+	if (!IN_FILE(h->SectionsOffset, NumberOfSections * sizeof(SnapshotSection))) {
+		::SetLastError(ERROR_BAD_FORMAT);
+		return FALSE;
+	}
+	for (size_t i = 0; i < NumberOfSections; ++i) {
+		const SnapshotSection& s = ((const SnapshotSection*)(base + h->SectionsOffset))[i];
+		if (s.BlockCount > size / sizeof(DWORD) || !IN_FILE(s.HashOffset, s.BlockCount * sizeof(DWORD))) {
+			::SetLastError(ERROR_BAD_FORMAT);
+			return FALSE;
+		}
+	}
+	#undef IN_FILE
+	mSnapshot = h;
+	return TRUE;
+}
+
+/** ǂݍ񂾃C[W̃ZNV\AZNVf[^Af[^fBNg͈̔͂xA
+ * rŎg Span . ZNV\t@CɎ܂ȂΎsƂ.
+ * ZNVf[^t@Czꍇ́A܂镔܂łɐ؂l߂.
+ */
+BOOL ExeFileImage::validate()
+{
+	const uchar* end = MappedAddress + SizeOfImage;		// SizeOfImage ̓t@CTCY.
+	if ((const uchar*)FileHeader < MappedAddress || (const uchar*)(FileHeader + 1) > end
+		|| (const uchar*)Sections < MappedAddress || (const uchar*)(Sections + NumberOfSections) > end) {
+		::SetLastError(ERROR_BAD_FORMAT);
+		return FALSE;
+	}
+
+	// XibvVbgł́At@C̃TCYœ؂l߂sAf[^͎Ȃ.
+	const size_t filesize = IsSnapshot() ? mSnapshot->FileSize : SizeOfImage;
+	mRawData = new Span[NumberOfSections + 1];	// NumberOfSections == 0 łLȔzɂ.
+	for (size_t i = 0; i < NumberOfSections; ++i) {
+		const IMAGE_SECTION_HEADER& sec = Sections[i];
+		size_t size = size_of_rawdata(sec);
+		if (size != 0 && (sec.PointerToRawData >= filesize || size > filesize - sec.PointerToRawData)) {
+			if (!IsSnapshot())
+				fprintf(stderr, "%s: Section RawData[%lu] %s exceeds file size, truncated.\n",
+					ModuleName, (ulong)i+1, SectionNameString(sec.Name));
+			size = sec.PointerToRawData >= filesize ? 0 : filesize - sec.PointerToRawData;
+		}
+		mRawData[i].data = (size && !IsSnapshot()) ? MappedAddress + sec.PointerToRawData : NULL;
+		mRawData[i].size = size;
+		if (IsSnapshot() && snapshotSection(i).BlockCount != (size + BlockSize() - 1) / BlockSize()) {
+			::SetLastError(ERROR_BAD_FORMAT);
+			return FALSE;
+		}
+	}
+
+	memset(mDirectories, 0, sizeof(mDirectories));
+	if (!IsSnapshot()) {
+		for (size_t i = 0; i < NumberOfDirectories(); ++i) {
+			const IMAGE_DATA_DIRECTORY& d = FileHeader->OptionalHeader.DataDirectory[i];
+			if (d.Size == 0 || i == IMAGE_DIRECTORY_ENTRY_SECURITY)	// SECURITYRVAłȂt@Cʒu.
+				continue;
+			const uchar* p = RvaToPtr(d.VirtualAddress, d.Size);
+			if (p != NULL) {
+				mDirectories[i].data = p;
+				mDirectories[i].size = d.Size;
+			}
+		}
+	}
+	return TRUE;
+}
+
+size_t ExeFileImage::NumberOfDirectories() const
+{
+	const size_t offset = offsetof(IMAGE_NT_HEADERS, OptionalHeader) + offsetof(IMAGE_OPTIONAL_HEADER, DataDirectory);
+	size_t n = FileHeader->OptionalHeader.NumberOfRvaAndSizes;
+	n = min(n, (size_t)IMAGE_NUMBEROF_DIRECTORY_ENTRIES);
+	size_t limit = FileHeader->FileHeader.SizeOfOptionalHeader + offsetof(IMAGE_NT_HEADERS, OptionalHeader);
+	limit = limit > offset ? (limit - offset) / sizeof(IMAGE_DATA_DIRECTORY) : 0;
+	return min(n, limit);
+}
+
+/** \Ԃ. s\ɑ΂Ă'.'Ԃ */
+inline int ascii(int c)
+{
+	return (!iscntrl(c) && isprint(c)) ? c : '.';
+}
+
+const char* ImageCharacteristicsString(WORD flags, char* buf=NULL)
+{
+	static char mybuf[20*16];
+	if (!buf) buf = mybuf;
+	sprintf(buf, "%04X(", flags);
+
+	#define M(f, id)	if (flags & f) strcat(buf, id ", ")
+	M(IMAGE_FILE_RELOCS_STRIPPED, "relocations stripped");		// Relocation information is stripped from the file. 
+	M(IMAGE_FILE_EXECUTABLE_IMAGE, "executable image");			// The file is executable (there are no unresolved external references). 
+	M(IMAGE_FILE_LINE_NUMS_STRIPPED, "linenumbers stripped");	// Line numbers are stripped from the file. 
+	M(IMAGE_FILE_LOCAL_SYMS_STRIPPED, "symbols stripped");		// Local symbols are stripped from file. 
+	M(IMAGE_FILE_AGGRESIVE_WS_TRIM, "AGGRESIVE_WS_TRIM");		// Aggressively trim the working set. 
+	M(IMAGE_FILE_LARGE_ADDRESS_AWARE, "LARGE_ADDRESS_AWARE");	// The application can handle addresses larger than 2 GB. 
+	M(IMAGE_FILE_BYTES_REVERSED_LO, "BYTES_REVERSED_LO");		// Bytes of the word are reversed. 
+	M(IMAGE_FILE_32BIT_MACHINE,  "32BIT_MACHINE");				// Computer supports 32-bit words. 
+	M(IMAGE_FILE_DEBUG_STRIPPED, "debuginfo stripped");			// Debugging information is stored separately in a .dbg file. 
+	M(IMAGE_FILE_REMOVABLE_RUN_FROM_SWAP, "REMOVABLE_RUN_FROM_SWAP");// If the image is on removable media, copy and run from the swap file. 
+	M(IMAGE_FILE_NET_RUN_FROM_SWAP, "NET_RUN_FROM_SWAP");		// If the image is on the network, copy and run from the swap file. 
+	M(IMAGE_FILE_SYSTEM, "system file");						// SYSTEM System file. 
+	M(IMAGE_FILE_DLL, "DLL file");								//  DLL file. 
+	M(IMAGE_FILE_UP_SYSTEM_ONLY, "UP_SYSTEM_ONLY");				// File should be run only on a uniprocessor computer. 
+	M(IMAGE_FILE_BYTES_REVERSED_HI, "BYTES_REVERSED_HI");		// Bytes of the word are reversed. 
+	#undef M
+
+	char* last_comma = strrchr(buf, ',');
+	if (last_comma) *last_comma = '\0';
+	strcat(buf, ")");
+
+	return buf;
+}
+
+const char* SectionCharacteristicsString(DWORD flags, char* buf=NULL)
+{
+	static char mybuf[20*32];
+	if (!buf) buf = mybuf;
+	sprintf(buf, "%08X(", flags);
+
+	#define M(f, id)	if (flags & f) strcat(buf, id ", ")
+//	M(IMAGE_SCN_TYPE_REG,    "*reg");
+//	M(IMAGE_SCN_TYPE_DSECT,  "*dsect");
+//	M(IMAGE_SCN_TYPE_NOLOAD, "*noload");
+//	M(IMAGE_SCN_TYPE_GROUP,  "*group");
+	M(IMAGE_SCN_TYPE_NO_PAD, "*no pad");
+//	M(IMAGE_SCN_TYPE_COPY,   "*copy");
+
+	M(IMAGE_SCN_CNT_CODE, "code");
+	M(IMAGE_SCN_CNT_INITIALIZED_DATA, "data");
+	M(IMAGE_SCN_CNT_UNINITIALIZED_DATA, "bss");
+
+//	M(IMAGE_SCN_LNK_OTHER, "*other");
+	M(IMAGE_SCN_LNK_INFO,  "*info");
+//	M(IMAGE_SCN_TYPE_OVER, "*over");
+	M(IMAGE_SCN_LNK_COMDAT, "comdat");
+
+	M(IMAGE_SCN_MEM_FARDATA,   "*fardata");
+	M(IMAGE_SCN_MEM_PURGEABLE, "*purgeable");
+	M(IMAGE_SCN_MEM_16BIT,     "*16bit");
+	M(IMAGE_SCN_MEM_LOCKED,    "*locked");
+	M(IMAGE_SCN_MEM_PRELOAD,   "*preload");
+
+	M(IMAGE_SCN_ALIGN_1BYTES,   "1-byte align");
+	M(IMAGE_SCN_ALIGN_2BYTES,   "2-byte align");
+	M(IMAGE_SCN_ALIGN_4BYTES,   "4-byte align");
+	M(IMAGE_SCN_ALIGN_8BYTES,   "8-byte align");
+	M(IMAGE_SCN_ALIGN_16BYTES, "16-byte align");
+	M(IMAGE_SCN_ALIGN_32BYTES, "32-byte align");
+	M(IMAGE_SCN_ALIGN_64BYTES, "64-byte align");
+
+	M(IMAGE_SCN_LNK_NRELOC_OVFL, "extended relocations");
+	M(IMAGE_SCN_MEM_DISCARDABLE, "discardable");
+	M(IMAGE_SCN_MEM_NOT_CACHED, "cannot be cached");
+	M(IMAGE_SCN_MEM_NOT_PAGED, "cannot be paged");
+	M(IMAGE_SCN_MEM_SHARED,  "shared");
+	M(IMAGE_SCN_MEM_EXECUTE, "execute");
+	M(IMAGE_SCN_MEM_READ,    "read");
+	M(IMAGE_SCN_MEM_WRITE,   "write");
+	#undef M
+
+	char* last_comma = strrchr(buf, ',');
+	if (last_comma) *last_comma = '\0';
+	strcat(buf, ")");
+
+	return buf;
+}
+
+const char* SubsystemString(WORD value, char* buf=NULL)
+{
+	static char mybuf[100];
+	if (!buf) buf = mybuf;
+
+	// http://msdn.microsoft.com/en-us/library/ms680339(VS.85).aspx
+	// Subsystem
+	const char* id = "?";
+	switch (value) {
+	#define C(v, name)	case v: id = name
+	C(IMAGE_SUBSYSTEM_UNKNOWN,        "unknown");         break;		// Unknown subsystem.
+	C(IMAGE_SUBSYSTEM_NATIVE,         "native");          break; 		// No subsystem required (device drivers and native system processes).
+	C(IMAGE_SUBSYSTEM_WINDOWS_GUI,    "Windows GUI");     break;		// Windows graphical user interface (GUI) subsystem.
+	C(IMAGE_SUBSYSTEM_WINDOWS_CUI,    "Windows console"); break;		// Windows character-mode user interface (CUI) subsystem.
+	C(IMAGE_SUBSYSTEM_OS2_CUI,        "OS/2 console");    break;		// OS/2 CUI subsystem.
+	C(IMAGE_SUBSYSTEM_POSIX_CUI,      "POSIX console");   break;		// POSIX CUI subsystem.
+	C(IMAGE_SUBSYSTEM_NATIVE_WINDOWS, "native Win9x driver"); break;	// image is a native Win9x driver.
+	C(IMAGE_SUBSYSTEM_WINDOWS_CE_GUI, "Windows CE");      break;		// Windows CE system.
+	C(IMAGE_SUBSYSTEM_EFI_APPLICATION,         "Extensible Firmware Interface(EFI) application"); break;
+	C(IMAGE_SUBSYSTEM_EFI_BOOT_SERVICE_DRIVER, "Extensible Firmware Interface(EFI) driver with boot services"); break;
+	C(IMAGE_SUBSYSTEM_EFI_RUNTIME_DRIVER,      "Extensible Firmware Interface(EFI) driver with run-time services"); break;
+	C(IMAGE_SUBSYSTEM_EFI_ROM,                 "Extensible Firmware Interface(EFI) ROM image"); break;
+	C(IMAGE_SUBSYSTEM_XBOX,                    "Xbox system"); break;
+	C(IMAGE_SUBSYSTEM_WINDOWS_BOOT_APPLICATION,"Boot application"); break;
+	#undef C
+	}
+	sprintf(buf, "%04X(%s)", value, id);
+	return buf;
+}
+
+const char* MachineString(WORD value, char* buf=NULL)
+{
+	static char mybuf[100];
+	if (!buf) buf = mybuf;
+
+	const char* id = "?";
+	switch (value) {
+	#define C(v, name)	case v: id = name
+	C(IMAGE_FILE_MACHINE_I386,   "32-bit Intel"); break;
+	C(IMAGE_FILE_MACHINE_IA64,   "64-bit Intel"); break;
+	C(IMAGE_FILE_MACHINE_AMD64,  "64-bit AMD"); break;
+	C(IMAGE_FILE_MACHINE_ALPHA,  "DEC Alpha"); break;
+	C(IMAGE_FILE_MACHINE_POWERPC,"Power PC"); break;
+	#undef C
+	}
+	sprintf(buf, "%04X(%s)", value, id);
+	return buf;
+}
+
+const char* TimeDateString(DWORD t, char* buf=NULL)
+{
+	static char mybuf[100];
+	if (!buf) buf = mybuf;
+	time_t timet = t;
+
+	const char* s = ctime(&timet); if (!s) s = "? ";
+	sprintf(buf, "%08X(%.*s)", t, (int)strlen(s)-1, s);	// ctime Ԃt͖ɉst̂ŁAő咷w肵Ĕ.
+
+	return buf;
+}
+
+#define PRINTLONG(f,m)		printf("%24s : %08X\n", #m, (f).m)
+#define PRINTWORD(f,m)		printf("%24s : %04X\n", #m, (f).m)
+#define PRINTVER(f,m)		printf("%24s : %d.%d\n", #m, (f).Major##m, (f).Minor##m)
+#define PRINTSTR(f,m)		printf("%24s : %s\n", #m, (f).m)
+#define PRINTSTRF(f,m,fn)	printf("%24s : %s\n", #m, fn((f).m))
+
+#define DIFFPRINTF(args)	(gQuiet ? (void)0 : (void)printf args)
+#define DIFFLONG(f,m)		if ((f##1).m != (f##2).m) { ++differ; DIFFPRINTF(("\n%s.%s:\n<%08X\n>%08X\n", prompt, #m, (f##1).m, (f##2).m)); }
+#define DIFFWORD(f,m)		if ((f##1).m != (f##2).m) { ++differ; DIFFPRINTF(("\n%s.%s:\n<%04X\n>%04X\n", prompt, #m, (f##1).m, (f##2).m)); }
+#define DIFFVER(f,m)		if ((f##1).Major##m != (f##2).Major##m || (f##1).Minor##m != (f##2).Minor##m) { ++differ; \
+								DIFFPRINTF(("\n%s.%s:\n<%d.%d\n>%d.%d\n", prompt, #m, \
+										(f##1).Major##m, (f##1).Minor##m, \
+										(f##2).Major##m, (f##2).Minor##m)); }
+#define DIFFSTR(f,m)		if (!strequ((f##1).m, (f##2).m)) { ++differ; DIFFPRINTF(("\n%s.%s:\n<%s\n>%s\n", prompt, #m, (f##1).m, (f##2).m)); }
+#define DIFFSTRF(f,m,fn)	if ((f##1).m != (f##2).m) { ++differ; DIFFPRINTF(("\n%s.%s:\n<%s\n", prompt, #m, fn((f##1).m))); DIFFPRINTF((">%s\n", fn((f##2).m))); }
+
+void dump_header(const IMAGE_FILE_HEADER& file)
+{
+	PRINTSTRF(file, Machine, MachineString);
+	PRINTWORD(file, NumberOfSections);
+	PRINTSTRF(file, TimeDateStamp, TimeDateString);
+	PRINTLONG(file, PointerToSymbolTable);
+	PRINTLONG(file, NumberOfSymbols);
+	PRINTWORD(file, SizeOfOptionalHeader);
+	PRINTSTRF(file, Characteristics, ImageCharacteristicsString);
+}
+
+int diff_header(const char* prompt, const IMAGE_FILE_HEADER& file1, const IMAGE_FILE_HEADER& file2)
+{
+	int differ = 0;
+	DIFFSTRF(file, Machine, MachineString);
+	DIFFWORD(file, NumberOfSections);
+	if (!gIgnoreTimeStamp) { DIFFSTRF(file, TimeDateStamp, TimeDateString); }
+	DIFFLONG(file, PointerToSymbolTable);
+	DIFFLONG(file, NumberOfSymbols);
+	DIFFWORD(file, SizeOfOptionalHeader);
+	DIFFSTRF(file, Characteristics, ImageCharacteristicsString);
+	return differ;
+}
+
+void dump_header(const IMAGE_OPTIONAL_HEADER& opt)
+{
+	PRINTWORD(opt, Magic);
+	PRINTVER (opt, LinkerVersion);
+	PRINTLONG(opt, SizeOfCode);
 	PRINTLONG(opt, SizeOfInitializedData);
 	PRINTLONG(opt, SizeOfUninitializedData);
 	PRINTLONG(opt, AddressOfEntryPoint);
@@ -542,246 +2078,2020 @@ void dump_header(const IMAGE_OPTIONAL_HEADER& opt)
 	PRINTLONG(opt, LoaderFlags);
 	PRINTLONG(opt, NumberOfRvaAndSizes);
 
-	printf("----- Rva, Size -----\n");
-	for (size_t i = 0; i < opt.NumberOfRvaAndSizes; ++i) {
-		const IMAGE_DATA_DIRECTORY& d = opt.DataDirectory[i];
-		printf("%20s[%2u] : %08X, %08X\n", "DataDirectory", i, d.VirtualAddress, d.Size);
+	printf("----- Rva, Size -----\n");
+	for (size_t i = 0; i < opt.NumberOfRvaAndSizes && i < IMAGE_NUMBEROF_DIRECTORY_ENTRIES; ++i) {
+		const IMAGE_DATA_DIRECTORY& d = opt.DataDirectory[i];
+		printf("%20s[%2lu] : %08X, %08X\n", "DataDirectory", (ulong)i, d.VirtualAddress, d.Size);
+	}
+}
+
+int diff_header(const char* prompt, const IMAGE_OPTIONAL_HEADER& opt1, const IMAGE_OPTIONAL_HEADER& opt2)
+{
+	int differ = 0;
+	DIFFWORD(opt, Magic);
+	DIFFVER (opt, LinkerVersion);
+	DIFFLONG(opt, SizeOfCode);
+	DIFFLONG(opt, SizeOfInitializedData);
+	DIFFLONG(opt, SizeOfUninitializedData);
+	DIFFLONG(opt, AddressOfEntryPoint);
+	DIFFLONG(opt, BaseOfCode);
+	DIFFLONG(opt, BaseOfData);
+	DIFFLONG(opt, ImageBase);
+	DIFFLONG(opt, SectionAlignment);
+	DIFFLONG(opt, FileAlignment);
+	DIFFVER (opt, OperatingSystemVersion);
+	DIFFVER (opt, ImageVersion);
+	DIFFVER (opt, SubsystemVersion);
+	DIFFLONG(opt, Win32VersionValue);
+	DIFFLONG(opt, SizeOfImage);
+	DIFFLONG(opt, SizeOfHeaders);
+	if (!gIgnoreCheckSum) { DIFFLONG(opt, CheckSum); }
+	DIFFSTRF(opt, Subsystem, SubsystemString);
+	DIFFWORD(opt, DllCharacteristics);
+	DIFFLONG(opt, SizeOfStackReserve);
+	DIFFLONG(opt, SizeOfStackCommit);
+	DIFFLONG(opt, SizeOfHeapReserve);
+	DIFFLONG(opt, SizeOfHeapCommit);
+	DIFFLONG(opt, LoaderFlags);
+	DIFFLONG(opt, NumberOfRvaAndSizes);
+
+/** @todo differ Rva,Size */
+//	printf("----- Rva, Size -----\n");
+//	for (size_t i = 0; i < opt.NumberOfRvaAndSizes; ++i) {
+//		const IMAGE_DATA_DIRECTORY& d = opt.DataDirectory[i];
+//		printf("%20s[%2u] : %08X, %08X\n", "DataDirectory", i, d.VirtualAddress, d.Size);
+//	}
+	return differ;
+}
+
+void dump_header(const IMAGE_SECTION_HEADER& sec)
+{
+	PRINTSTRF(sec, Name, SectionNameString);
+	PRINTLONG(sec.Misc, VirtualSize);
+	PRINTLONG(sec, VirtualAddress);
+	PRINTLONG(sec, SizeOfRawData);
+	PRINTLONG(sec, PointerToRawData);
+	PRINTLONG(sec, PointerToRelocations);
+	PRINTLONG(sec, PointerToLinenumbers);
+	PRINTWORD(sec, NumberOfRelocations);
+	PRINTWORD(sec, NumberOfLinenumbers);
+	PRINTSTRF(sec, Characteristics, SectionCharacteristicsString);
+}
+
+int diff_header(const char* prompt, const IMAGE_SECTION_HEADER& sec1, const IMAGE_SECTION_HEADER& sec2)
+{
+	// DIFF}Ng߂̌떂.
+	struct {
+		DWORD VirtualSize;
+	} misc1, misc2;
+	misc1.VirtualSize = sec1.Misc.VirtualSize;
+	misc2.VirtualSize = sec2.Misc.VirtualSize;
+
+	// Name8傤ǂNULI[Ȃ̂ŁAI[ʂŔr.
+	struct {
+		char Name[IMAGE_SIZEOF_SHORT_NAME + 1];
+	} name1, name2;
+	SectionNameString(sec1.Name, name1.Name);
+	SectionNameString(sec2.Name, name2.Name);
+
+	int differ = 0;
+	DIFFSTR(name, Name);
+	DIFFLONG(misc, VirtualSize);
+	DIFFLONG(sec, VirtualAddress);
+	DIFFLONG(sec, SizeOfRawData);
+	DIFFLONG(sec, PointerToRawData);
+	DIFFLONG(sec, PointerToRelocations);
+	DIFFLONG(sec, PointerToLinenumbers);
+	DIFFWORD(sec, NumberOfRelocations);
+	DIFFWORD(sec, NumberOfLinenumbers);
+	DIFFSTRF(sec, Characteristics, SectionCharacteristicsString);
+	return differ;
+}
+
+void dump_rawdata(const char* prompt, const UCHAR* p, size_t n)
+{
+	char dump[16*3+1];
+	char asc[16+1];
+	size_t i = 0, j = 0;
+	while (j < n) {
+		int c = p[j++];
+		sprintf(dump + i*3, "%02X%c", c, i==7 ? '-' : ' ');
+		asc[i] = ascii(c);
+		if (++i >= 16) {
+			asc[16] = 0;
+			printf("%14s +%08lX : %-48s:%-16s\n", prompt, (ulong)(j-i), dump, asc);
+			i = 0;
+		}
+	}//.endwhile
+	if (i != 0) {
+		asc[i] = 0;
+		printf("%14s +%08lX : %-48s:%-16s\n", prompt, (ulong)(j-i), dump, asc);
+	}
+}
+
+//------------------------------------------------------------------------
+///@name oCgz̕
+/// ωZNVAkEÍꂽf[^AR[h\A0߂肪ɂ.
+/// -e w莞vẐŁAʏ̔rɂ͕SȂ.
+//@{
+/** Ƃ͂̑̕傫. */
+const size_t PROFILE_WINDOW = 4096;
+
+/** ̒ȏ㑱0x00A0̕(lߕ▢̕\)ƂĐ. */
+const size_t PROFILE_ZERO_RUN = 16;
+
+/** oCg̕z. */
+struct ByteProfile {
+	size_t size;
+	size_t hist[256];		///< oCglƂ̏o.
+	size_t zeroRuns;		///< PROFILE_ZERO_RUN ȏ㑱0x00̕т̐.
+	size_t longestZeroRun;	///< ł0x00̐.
+
+	/** ShannonGgs[(bits/byte). 0`8. */
+	double Entropy() const;
+
+	/** 0x00̊(%). */
+	double ZeroRatio() const {
+		return size ? hist[0] * 100.0 / size : 0;
+	}
+
+	/** Ggs[0̊ɂA܂ȓe̕. */
+	const char* Kind() const;
+};
+
+double ByteProfile::Entropy() const
+{
+	double e = 0;
+	for (size_t c = 0; c < 256; ++c) {
+		if (hist[c] != 0) {
+			double p = (double)hist[c] / size;
+			e -= p * log(p);
+		}
+	}
+	return e / log(2.0);
+}
+
+const char* ByteProfile::Kind() const
+{
+	double e = Entropy();
+	if (size == 0)			return "empty";
+	if (ZeroRatio() >= 90)	return "zero-filled";
+	if (e >= 7.2)			return "packed";		// k܂͈Íꂽf[^.
+	if (e >= 5.0)			return "code/data";
+	if (e >= 2.0)			return "text/table";
+	return "sparse";
+}
+
+/** pnoCg̕z1̑ŋ߂.
+ * oCglƏo̍XVO̍XV҂̂ŁA4̕\ɐU蕪ĈˑfAŌɍZ.
+ * 0̕т̒Ő.
+ */
+void profile_bytes(const UCHAR* p, size_t n, ByteProfile& prof)
+{
+	size_t hist[4][256];
+	memset(hist, 0, sizeof(hist));
+	size_t run = 0, runs = 0, longest = 0;
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		UCHAR c0 = p[i], c1 = p[i+1], c2 = p[i+2], c3 = p[i+3];
+		++hist[0][c0]; ++hist[1][c1]; ++hist[2][c2]; ++hist[3][c3];
+		if ((c0 | c1 | c2 | c3) == 0) {		// 4oCgƂ0ȂAтL΂.
+			run += 4;
+			continue;
+		}
+		for (size_t k = 0; k < 4; ++k) {
+			if (p[i+k] == 0) {
+				++run;
+				continue;
+			}
+			if (run >= PROFILE_ZERO_RUN) ++runs;
+			if (run > longest) longest = run;
+			run = 0;
+		}
+	}
+	for (; i < n; ++i) {
+		++hist[0][p[i]];
+		if (p[i] == 0) {
+			++run;
+			continue;
+		}
+		if (run >= PROFILE_ZERO_RUN) ++runs;
+		if (run > longest) longest = run;
+		run = 0;
+	}
+	if (run >= PROFILE_ZERO_RUN) ++runs;
+	if (run > longest) longest = run;
+
+	prof.size = n;
+	for (size_t c = 0; c < 256; ++c)
+		prof.hist[c] = hist[0][c] + hist[1][c] + hist[2][c] + hist[3][c];
+	prof.zeroRuns = runs;
+	prof.longestZeroRun = longest;
+}
+
+/** z̗v1sŏ. */
+const char* ProfileString(const ByteProfile& prof)
+{
+	static char buf[100];
+	sprintf(buf, "entropy %4.2f, zeros %5.1f%%, zero runs %lu (longest %lu): %s",
+		prof.Entropy(), prof.ZeroRatio(), (ulong)prof.zeroRuns, (ulong)prof.longestZeroRun, prof.Kind());
+	return buf;
+}
+
+/** ZNVf[^̕zAŜƑƂɕ\. _v(-d -e)Ŏg. */
+void dump_profile(const char* prompt, const UCHAR* p, size_t n)
+{
+	ByteProfile prof;
+	profile_bytes(p, n, prof);
+	printf("%14s %9s : %s\n", prompt, "total", ProfileString(prof));
+	for (size_t offset = 0; offset < n; offset += PROFILE_WINDOW) {
+		profile_bytes(p + offset, min(PROFILE_WINDOW, n - offset), prof);
+		printf("%14s +%08lX : %4.2f %5.1f%% %s\n", prompt, (ulong)offset, prof.Entropy(), prof.ZeroRatio(), prof.Kind());
+	}
+}
+
+/** قȂZNVf[^̕zׂĕ\. ŜƁAeقȂ鑋(-n#܂)̗vׂ. */
+void diff_profile(const char* prompt, const UCHAR* p1, size_t n1, const UCHAR* p2, size_t n2)
+{
+	if (gQuiet)		// \Ȃ̂ŁAz߂邾.
+		return;
+	ByteProfile prof1, prof2;
+	profile_bytes(p1, n1, prof1);
+	profile_bytes(p2, n2, prof2);
+	printf("\n%s\n", prompt);
+	printf("<%s\n", ProfileString(prof1));
+	printf(">%s\n", ProfileString(prof2));
+
+	size_t differ = 0;
+	for (size_t offset = 0; offset < n1 || offset < n2; offset += PROFILE_WINDOW) {
+		size_t len1 = offset < n1 ? min(PROFILE_WINDOW, n1 - offset) : 0;
+		size_t len2 = offset < n2 ? min(PROFILE_WINDOW, n2 - offset) : 0;
+		if (len1 == len2 && memcmp(p1 + offset, p2 + offset, len1) == 0)
+			continue;
+		if (++differ > gDiffLength) {
+			printf("\t<snip> differ more than %lu windows.\n", (ulong)gDiffLength);
+			break;
+		}
+		char w1[30], w2[30];
+		strcpy(w1, "-----");
+		strcpy(w2, "-----");
+		if (len1) {
+			profile_bytes(p1 + offset, len1, prof1);
+			sprintf(w1, "%4.2f %s", prof1.Entropy(), prof1.Kind());
+		}
+		if (len2) {
+			profile_bytes(p2 + offset, len2, prof2);
+			sprintf(w2, "%4.2f %s", prof2.Entropy(), prof2.Kind());
+		}
+		printf("+%08lX: %s <=> %s\n", (ulong)offset, w1, w2);
+	}//.endfor
+}
+//@}
+
+/** p1p2̍ŏ̕svʒuԂ. SĈvnԂ.
+ * v镔memcmp(CRT̃xNg)ŉ򂲂Ƃɓǂݔ΂.
+ */
+size_t mismatch(const UCHAR* p1, const UCHAR* p2, size_t n)
+{
+	const size_t CHUNK = 256;
+	size_t i = 0;
+	while (i + CHUNK <= n && memcmp(p1 + i, p2 + i, CHUNK) == 0)
+		i += CHUNK;
+	while (i < n && p1[i] == p2[i])
+		++i;
+	return i;
+}
+
+//........................................................................
+/** r1. */
+struct ScanJob {
+	const UCHAR* p1;
+	const UCHAR* p2;
+	size_t n;
+	volatile LONG* found;	///< ǂꂩ̋ԂŕsvΔ0. ̋Ԃ͂đł؂.
+};
+
+/** found ǂ. ̃Xbhނ̂ŁAݑƓsȑœǂ. */
+inline bool scan_found(volatile LONG* found)
+{
+#ifdef _WIN32
+	return ::InterlockedCompareExchange(found, 0, 0) != 0;
+#else
+	return __atomic_load_n(found, __ATOMIC_RELAXED) != 0;
+#endif
+}
+
+/** ԂrAsv found 𗧂Ă. ̋ԂɌł؂. */
+void scan_job(const ScanJob& job)
+{
+	const size_t STEP = 64*1024;
+	for (size_t i = 0; i < job.n && !scan_found(job.found); i += STEP) {
+		if (memcmp(job.p1 + i, job.p2 + i, min(STEP, job.n - i)) != 0) {
+#ifdef _WIN32
+			::InterlockedExchange(job.found, 1);
+#else
+			__atomic_store_n(job.found, 1, __ATOMIC_RELAXED);
+#endif
+			break;
+		}
+	}
+}
+
+#ifdef _WIN32
+DWORD WINAPI scan_thread(void* job)
+{
+	scan_job(*(const ScanJob*)job);
+	return 0;
+}
+#else
+void* scan_thread(void* job)
+{
+	scan_job(*(const ScanJob*)job);
+	return NULL;
+}
+#endif
+
+/** _vZbT. */
+size_t processor_count()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	::GetSystemInfo(&info);
+	return info.dwNumberOfProcessors;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? n : 1;
+#endif
+}
+
+/** p1p2noCg͑Sē?
+ * 傫Ȕ͈͂͋Ԃɕ -j# ̃XbhŕsɔrAǂꂩsvŜł؂.
+ * XbhȂԂ́AĂяõXbhŔr.
+ */
+bool equal_bytes(const UCHAR* p1, const UCHAR* p2, size_t n)
+{
+	const size_t MIN_JOB = 1024*1024;	// 菬Ԃ̓XbhԂ̕傫.
+	const size_t MAX_JOBS = 64;			// WaitForMultipleObjects ̏.
+	size_t jobs = gThreads ? gThreads : processor_count();
+	jobs = min(min(jobs, MAX_JOBS), n / MIN_JOB);
+	if (jobs <= 1)
+		return mismatch(p1, p2, n) == n;
+
+	volatile LONG found = 0;
+	ScanJob job[MAX_JOBS];
+#ifdef _WIN32
+	HANDLE thread[MAX_JOBS];
+#else
+	pthread_t thread[MAX_JOBS];
+#endif
+	bool started[MAX_JOBS];
+	size_t each = n / jobs;
+	for (size_t i = 0; i < jobs; ++i) {
+		job[i].p1 = p1 + i * each;
+		job[i].p2 = p2 + i * each;
+		job[i].n = (i + 1 == jobs) ? n - i * each : each;
+		job[i].found = &found;
+	}
+	// 0͌ĂяõXbhŔr.
+	for (size_t i = 1; i < jobs; ++i) {
+#ifdef _WIN32
+		thread[i] = ::CreateThread(NULL, 0, scan_thread, &job[i], 0, NULL);
+		started[i] = thread[i] != NULL;
+#else
+		started[i] = pthread_create(&thread[i], NULL, scan_thread, &job[i]) == 0;
+#endif
+	}
+	scan_job(job[0]);
+	for (size_t i = 1; i < jobs; ++i) {
+		if (!started[i]) {
+			scan_job(job[i]);
+			continue;
+		}
+#ifdef _WIN32
+		::WaitForSingleObject(thread[i], INFINITE);
+		::CloseHandle(thread[i]);
+#else
+		pthread_join(thread[i], NULL);
+#endif
+	}
+	return !scan_found(&found);
+}
+
+int diff_rawdata(const char* prompt, const UCHAR* p1, size_t n1, const UCHAR* p2, size_t n2)
+{
+	if (gBrief)		// ق̈ʒu͗vȂ.
+		return n1 != n2 || !equal_bytes(p1, p2, n1);
+
+	size_t differ = 0;
+	const size_t n = min(n1, n2);
+	for (size_t i = 0; i < n1 || i < n2; ++i) {
+		if (i < n) {
+			i += mismatch(p1 + i, p2 + i, n - i);
+			if (i >= n1 && i >= n2)
+				break;
+		}
+		int c1 = (i < n1) ? p1[i] : -1;
+		int c2 = (i < n2) ? p2[i] : -1;
+
+		if (c1 == c2) continue;
+
+		if (differ == 0)
+			DIFFPRINTF(("\n%s\n", prompt));
+
+		if (++differ > gDiffLength) {
+			DIFFPRINTF(("\t<snip> differ more than %lu bytes.\n", (ulong)gDiffLength));
+			break;
+		}
+
+		if (c1 == -1)
+			DIFFPRINTF(("+%08lX: ----- <=> %02X(%c)\n", (ulong)i, c2, ascii(c2)));
+		else if (c2 == -1)
+			DIFFPRINTF(("+%08lX: %02X(%c) <=> -----\n", (ulong)i, c1, ascii(c1)));
+		else
+			DIFFPRINTF(("+%08lX: %02X(%c) <=> %02X(%c)\n", (ulong)i, c1, ascii(c1), c2, ascii(c2)));
+	}//.endfor
+	return differ != 0;
+}
+
+bool ExeFileImage::MatchesSnapshot(const ExeFileImage& file) const
+{
+	if (!IsSnapshot() || file.IsSnapshot() || file.SizeOfImage != mSnapshot->FileSize)
+		return false;
+	return crc32(0, file.MappedAddress, file.SizeOfImage) == mSnapshot->FileCrc;
+}
+
+ulong ExeFileImage::BlockHash(size_t sec, size_t offset, size_t len) const
+{
+	if (mSnapshot != NULL) {
+		const DWORD* hashes = (const DWORD*)((const uchar*)mSnapshot + snapshotSection(sec).HashOffset);
+		return hashes[offset / mSnapshot->BlockSize];
+	}
+	return crc32(0, mRawData[sec].data + offset, len);
+}
+
+const uchar* ExeFileImage::RvaToPtr(DWORD rva, size_t size, size_t* avail) const
+{
+	for (size_t i = 0; i < NumberOfSections; ++i) {
+		const IMAGE_SECTION_HEADER& sec = Sections[i];
+		if (rva < sec.VirtualAddress || rva - sec.VirtualAddress >= sec.SizeOfRawData)
+			continue;
+		size_t offset = sec.PointerToRawData + (rva - sec.VirtualAddress);
+		size_t n = sec.SizeOfRawData - (rva - sec.VirtualAddress);
+		if (offset >= SizeOfImage)		// SizeOfImage ̓t@CTCY.
+			return NULL;
+		n = min(n, SizeOfImage - offset);
+		if (size > n)
+			return NULL;
+		if (avail != NULL)
+			*avail = n;
+		return MappedAddress + offset;
+	}
+	return NULL;
+}
+
+const char* ExeFileImage::RvaToString(DWORD rva) const
+{
+	size_t avail;
+	const char* s = (const char*)RvaToPtr(rva, 1, &avail);
+	return (s != NULL && memchr(s, '\0', avail) != NULL) ? s : NULL;
+}
+
+void ExeFileImage::GetExports(NameSet& names) const
+{
+	if (mSnapshot != NULL) {
+		names.AddPacked((const char*)mSnapshot + mSnapshot->ExportsOffset, mSnapshot->ExportsSize);
+		return;
+	}
+	const Span& d = Directory(IMAGE_DIRECTORY_ENTRY_EXPORT);
+	if (FileHeader->OptionalHeader.Magic != IMAGE_NT_OPTIONAL_HDR32_MAGIC || d.size < sizeof(IMAGE_EXPORT_DIRECTORY))
+		return;
+	const IMAGE_EXPORT_DIRECTORY* exp = (const IMAGE_EXPORT_DIRECTORY*)d.data;
+	const DWORD* addr = (const DWORD*)RvaToPtr(exp->AddressOfNames, exp->NumberOfNames * sizeof(DWORD));
+	if (addr == NULL || exp->NumberOfNames > SizeOfImage / sizeof(DWORD))
+		return;
+	for (DWORD i = 0; i < exp->NumberOfNames; ++i) {
+		const char* name = RvaToString(addr[i]);
+		if (name != NULL)
+			names.AddRef(name);
+	}
+	names.Sort();
+}
+
+void ExeFileImage::GetImports(NameSet& names) const
+{
+	if (mSnapshot != NULL) {
+		names.AddPacked((const char*)mSnapshot + mSnapshot->ImportsOffset, mSnapshot->ImportsSize);
+		return;
+	}
+	const Span& d = Directory(IMAGE_DIRECTORY_ENTRY_IMPORT);
+	if (FileHeader->OptionalHeader.Magic != IMAGE_NT_OPTIONAL_HDR32_MAGIC)
+		return;
+	for (size_t offset = 0; offset + sizeof(IMAGE_IMPORT_DESCRIPTOR) <= d.size; offset += sizeof(IMAGE_IMPORT_DESCRIPTOR)) {
+		const IMAGE_IMPORT_DESCRIPTOR* desc = (const IMAGE_IMPORT_DESCRIPTOR*)(d.data + offset);
+		if (desc->Name == 0)
+			break;
+		const char* dll = RvaToString(desc->Name);
+		if (dll == NULL)
+			break;
+		DWORD thunk = desc->OriginalFirstThunk ? desc->OriginalFirstThunk : desc->FirstThunk;
+		for (;; thunk += sizeof(DWORD)) {
+			const DWORD* t = (const DWORD*)RvaToPtr(thunk, sizeof(DWORD));
+			if (t == NULL || *t == 0)
+				break;
+			char buf[_MAX_PATH + 20];
+			if (*t & IMAGE_ORDINAL_FLAG32) {
+				_snprintf(buf, sizeof(buf), "%.*s!#%u", _MAX_PATH, dll, (unsigned)(*t & 0xFFFF));
+			}
+			else {
+				const char* fn = RvaToString(*t + 2);	// IMAGE_IMPORT_BY_NAME.Name
+				if (fn == NULL)
+					break;
+				_snprintf(buf, sizeof(buf), "%.*s!%.*s", _MAX_PATH / 2, dll, _MAX_PATH / 2, fn);
+			}
+			buf[sizeof(buf) - 1] = '\0';
+			names.Add(buf);
+		}
+	}
+	names.Sort();
+}
+
+/** 8oCgEɐ؂グ. */
+inline size_t align8(size_t n)
+{
+	return (n + 7) & ~(size_t)7;
+}
+
+/** [fp8oCgE܂Ői߂. */
+void pad8(FILE* fp)
+{
+	static const char zero[8] = { 0 };
+	long pos = ftell(fp);
+	fwrite(zero, align8(pos) - pos, 1, fp);
+}
+
+/** ȌWNULI[̕тƂď. */
+void write_names(FILE* fp, const NameSet& names)
+{
+	for (size_t i = 0; i < names.Count(); ++i)
+		fwrite(names[i], strlen(names[i]) + 1, 1, fp);
+}
+
+bool ExeFileImage::WriteSnapshot(const char* fname) const
+{
+	NameSet exports, imports;
+	GetExports(exports);
+	GetImports(imports);
+
+	const size_t block = gSnapshotBlockSize;
+	SnapshotHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.Magic, SNAPSHOT_MAGIC, sizeof(h.Magic));
+	h.Version        = SNAPSHOT_VERSION;
+	h.BlockSize      = (DWORD)block;
+	h.FileSize       = SizeOfImage;
+	h.FileCrc        = crc32(0, MappedAddress, SizeOfImage);
+	h.HeadersOffset  = sizeof(h);
+	h.HeadersSize    = (DWORD)((const uchar*)(Sections + NumberOfSections) - MappedAddress);
+	h.SectionsOffset = (DWORD)align8(h.HeadersOffset + h.HeadersSize);
+	size_t offset = align8(h.SectionsOffset + NumberOfSections * sizeof(SnapshotSection));
+	SnapshotSection* sections = new SnapshotSection[NumberOfSections + 1];
+	for (size_t i = 0; i < NumberOfSections; ++i) {
+		sections[i].HashOffset = (DWORD)offset;
+		sections[i].BlockCount = (DWORD)((RawData(i).size + block - 1) / block);
+		offset += sections[i].BlockCount * sizeof(DWORD);
+	}
+	h.ExportsOffset = (DWORD)offset;
+	h.ExportsSize   = (DWORD)exports.PackedSize();
+	h.ImportsOffset = h.ExportsOffset + h.ExportsSize;
+	h.ImportsSize   = (DWORD)imports.PackedSize();
+
+	FILE* fp = fopen(fname, "wb");
+	if (fp == NULL) {
+		delete[] sections;
+		return false;
+	}
+	fwrite(&h, sizeof(h), 1, fp);
+	fwrite(MappedAddress, h.HeadersSize, 1, fp);
+	pad8(fp);
+	fwrite(sections, sizeof(SnapshotSection), NumberOfSections, fp);
+	pad8(fp);
+	for (size_t i = 0; i < NumberOfSections; ++i) {
+		size_t n = RawData(i).size;
+		for (size_t offset = 0; offset < n; offset += block) {
+			DWORD hash = (DWORD)BlockHash(i, offset, min(block, n - offset));
+			fwrite(&hash, sizeof(hash), 1, fp);
+		}
+	}
+	write_names(fp, exports);
+	write_names(fp, imports);
+	delete[] sections;
+
+	bool ok = !ferror(fp);
+	if (fclose(fp) != 0)
+		ok = false;
+	if (!ok)
+		remove(fname);
+	return ok;
+}
+
+//------------------------------------------------------------------------
+/** t@C̗̈̎. -a Ńt@CŜRȂr邽߂Ɏg. */
+enum RegionKind {
+	REGION_DOS_HEADER,	///< DOSwb_DOSX^u. [0, e_lfanew)
+	REGION_HEADERS,		///< PEwb_ƃZNV\. \PʂŔrA-a ȂoCgƂĂr.
+	REGION_SECTION,		///< ZNVf[^. \PʂŔr.
+	REGION_PADDING,		///< ZNVf[^̔rΏۂ̌납 SizeOfRawData ܂ł̋lߕ.
+	REGION_CERTIFICATE,	///< ؖe[u. SECURITYfBNgt@CʒuŎw.
+	REGION_SLACK,		///< ǂQƂȂ. wb_̗]Ȃ.
+	REGION_OVERLAY,		///< Ō̃ZNVf[^́AǂQƂȂ.
+	REGION_KINDS
+};
+
+/** ̈̎ނ̕\. */
+const char* RegionKindString(RegionKind kind)
+{
+	static const char* const names[REGION_KINDS] = {
+		"DOS Header", "Headers", "Section", "Padding", "Certificate", "Slack", "Overlay" };
+	return names[kind];
+}
+
+/** t@C̗̈. */
+struct Region {
+	RegionKind kind;
+	size_t index;		///< SECTION/PADDING̓ZNVԍ, ȊO͎ނƂ1̒ʂԍ.
+	size_t offset;		///< t@Cʒu.
+	size_t size;		///< oCg.
+};
+
+/** t@CŜ̋ԕ\. eoCg傤ǈ̗̈Ɋ蓖āAt@Cʒuɕׂ.
+ * dȂ̈́AɎn܂(ʒuȂRegionKind̏)Ɋ蓖Ă.
+ */
+class RegionMap {
+	Region* mRegions;
+	size_t mCount;
+	RegionMap(const RegionMap&);		// don't copy
+	void operator=(const RegionMap&);	// don't assign
+public:
+	RegionMap(const ExeFileImage& exe);
+
+	~RegionMap() {
+		delete[] mRegions;
+	}
+
+	size_t Count() const {
+		return mCount;
+	}
+	const Region& operator[](size_t i) const {
+		return mRegions[i];
+	}
+
+	/** ނƔԍŗ̈T. NULL. */
+	const Region* Find(RegionKind kind, size_t index) const;
+};
+
+int compare_regions(const void* a, const void* b)
+{
+	const Region* r1 = (const Region*)a;
+	const Region* r2 = (const Region*)b;
+	if (r1->offset != r2->offset)
+		return r1->offset < r2->offset ? -1 : 1;
+	return (int)r1->kind - (int)r2->kind;
+}
+
+RegionMap::RegionMap(const ExeFileImage& exe)
+	: mRegions(NULL), mCount(0)
+{
+	const size_t filesize = exe.SizeOfImage;
+	const size_t nsec = exe.NumberOfSections;
+
+	//--- \QƂ̈W߂. t@Cz镔͐؂l߂.
+	Region* known = new Region[nsec * 2 + 3];
+	size_t n = 0;
+	#define ADD(k, i, off, len)	if ((off) < filesize && (len) != 0) { \
+									Region& r = known[n++]; r.kind = k; r.index = i; \
+									r.offset = off; r.size = min((size_t)(len), filesize - (off)); }
+	size_t lfanew = (const uchar*)exe.FileHeader - exe.MappedAddress;
+	size_t headers = (const uchar*)(exe.Sections + nsec) - exe.MappedAddress;
+	ADD(REGION_DOS_HEADER, 1, 0, lfanew);
+	ADD(REGION_HEADERS, 1, lfanew, headers - lfanew);
+	for (size_t i = 0; i < nsec; ++i) {
+		const IMAGE_SECTION_HEADER& sec = exe.Sections[i];
+		size_t size = exe.RawData(i).size;
+		ADD(REGION_SECTION, i+1, sec.PointerToRawData, size);
+		if (sec.SizeOfRawData > size)
+			ADD(REGION_PADDING, i+1, sec.PointerToRawData + size, sec.SizeOfRawData - size);
+	}
+	if (exe.NumberOfDirectories() > IMAGE_DIRECTORY_ENTRY_SECURITY) {
+		const IMAGE_DATA_DIRECTORY& d = exe.FileHeader->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_SECURITY];
+		ADD(REGION_CERTIFICATE, 1, d.VirtualAddress, d.Size);
+	}
+	#undef ADD
+	qsort(known, n, sizeof(Region), compare_regions);
+
+	//--- QƂȂԂ𖄂߂Ȃׂ. Ō̃ZNVf[^̌Ԃ̓I[o[CƂ.
+	size_t data_end = 0;
+	for (size_t i = 0; i < n; ++i) {
+		if (known[i].kind != REGION_CERTIFICATE)
+			data_end = max(data_end, known[i].offset + known[i].size);
+	}
+	mRegions = new Region[n * 2 + 1];
+	size_t count[REGION_KINDS] = { 0 };
+	size_t cursor = 0;
+	for (size_t i = 0; i <= n; ++i) {
+		size_t start = (i < n) ? known[i].offset : filesize;
+		if (start > cursor) {
+			Region& gap = mRegions[mCount++];
+			gap.kind   = cursor >= data_end ? REGION_OVERLAY : REGION_SLACK;
+			gap.index  = ++count[gap.kind];
+			gap.offset = cursor;
+			gap.size   = start - cursor;
+			cursor = start;
+		}
+		if (i == n)
+			break;
+		size_t end = known[i].offset + known[i].size;
+		if (end <= cursor)
+			continue;		// ̗̈Ɋ܂܂Ă.
+		Region& r = mRegions[mCount++];
+		r = known[i];
+		r.offset = cursor;
+		r.size = end - cursor;
+		cursor = end;
+	}
+	delete[] known;
+}
+
+const Region* RegionMap::Find(RegionKind kind, size_t index) const
+{
+	for (size_t i = 0; i < mCount; ++i) {
+		if (mRegions[i].kind == kind && mRegions[i].index == index)
+			return &mRegions[i];
+	}
+	return NULL;
+}
+
+void ExeFileImage::print() const
+{
+	printf("===== dump of \"%s\" =====\n", ModuleName);
+	PRINTLONG(*FileHeader, Signature);
+
+	printf("----- FileHeader -----\n");
+	dump_header(FileHeader->FileHeader);
+
+	printf("----- OptionalHeader -----\n");
+	dump_header(FileHeader->OptionalHeader);
+
+	for (size_t i = 0; i < NumberOfSections; ++i) {
+		const IMAGE_SECTION_HEADER& sec = Sections[i];
+
+		printf("----- Section Header[%lu] -----\n", (ulong)i+1);
+		dump_header(sec);
+
+		if (IsSnapshot()) {
+			size_t blocks = snapshotSection(i).BlockCount;
+			printf("----- Section BlockHash[%lu] (%lu blocks of %lu bytes) -----\n", (ulong)i+1, (ulong)blocks, (ulong)BlockSize());
+			for (size_t k = 0; k < blocks; ++k)
+				printf("%14s +%08lX : %08lX\n", SectionNameString(sec.Name), (ulong)(k * BlockSize()), BlockHash(i, k * BlockSize(), 0));
+			continue;
+		}
+		printf("----- Section RawData[%lu] (BaseAddress:%08lX, Size:%d bytes) -----\n", (ulong)i+1,
+			(ulong)(FileHeader->OptionalHeader.ImageBase + sec.VirtualAddress), sec.Misc.VirtualSize);
+		dump_rawdata(SectionNameString(sec.Name), RawData(i).data, RawData(i).size);
+
+		if (gProfile) {
+			printf("----- Section Profile[%lu] (%lu bytes, window %lu bytes) -----\n", (ulong)i+1, (ulong)RawData(i).size, (ulong)PROFILE_WINDOW);
+			dump_profile(SectionNameString(sec.Name), RawData(i).data, RawData(i).size);
+		}
+	}
+
+	if (gCompareAll && !IsSnapshot()) {
+		RegionMap map(*this);
+		printf("----- Region Map (FileSize:%u bytes) -----\n", SizeOfImage);
+		for (size_t i = 0; i < map.Count(); ++i) {
+			const Region& r = map[i];
+			printf("%20s[%2lu] : %08lX, %08lX\n", RegionKindString(r.kind), (ulong)r.index, (ulong)r.offset, (ulong)r.size);
+		}
+	}
+}
+
+/** ̈r̕p̂At@CʒuoffsetɂDWORD0ɂ. rɎ܂ȂΉȂ. */
+void mask_dword(uchar* p, const Region& r, size_t offset)
+{
+	if (offset >= r.offset && offset - r.offset < r.size && r.size - (offset - r.offset) >= sizeof(DWORD))
+		memset(p + (offset - r.offset), 0, sizeof(DWORD));
+}
+
+/** wb_̈̕. -t, -c Ŗ鍀ڂ0ɂāAoCg̔rōقƂȂ悤ɂ.
+ * @param r	REGION_HEADERS. ZNVf[^ƏdȂƁANTwb_̐擪n܂Ƃ͌Ȃ.
+ * @return new[] ̈.
+ */
+uchar* masked_headers(const ExeFileImage& exe, const Region& r)
+{
+	uchar* p = new uchar[r.size];
+	memcpy(p, exe.MappedAddress + r.offset, r.size);
+	const size_t nt = (const uchar*)exe.FileHeader - exe.MappedAddress;
+	if (gIgnoreTimeStamp)
+		mask_dword(p, r, nt + offsetof(IMAGE_NT_HEADERS, FileHeader.TimeDateStamp));
+	if (gIgnoreCheckSum)
+		mask_dword(p, r, nt + offsetof(IMAGE_NT_HEADERS, OptionalHeader.CheckSum));	// PE32+łʒu.
+	return p;
+}
+
+/** \Pʂł͔rȂ̈(DOSwb_AlߕAؖAԁAI[o[C)oCgƂĔr.
+ * wb_̈Adiff_header rȂ(Signature, DataDirectory, PE32+ŒȂ镔Ȃ)
+ * R炳Ȃ悤ɃoCgƂĔr.
+ * ށEԍ̗̈ǂrAЕɂ̈͑SoCgقƂ.
+ */
+int diff_regions(const ExeFileImage& exe1, const ExeFileImage& exe2)
+{
+	static const RegionKind kinds[] = {
+		REGION_DOS_HEADER, REGION_HEADERS, REGION_PADDING, REGION_CERTIFICATE, REGION_SLACK, REGION_OVERLAY };
+	RegionMap map1(exe1);
+	RegionMap map2(exe2);
+	int differ = 0;
+	for (size_t k = 0; k < sizeof(kinds)/sizeof(kinds[0]); ++k) {
+		for (size_t pass = 0; pass < 2; ++pass) {
+			// pass 0: map1̊ëmap2̑Ή̈, pass 1: map2ɂ̈.
+			const RegionMap& map = pass == 0 ? map1 : map2;
+			for (size_t i = 0; i < map.Count(); ++i) {
+				if (map[i].kind != kinds[k])
+					continue;
+				const Region* r1 = pass == 0 ? &map[i] : map1.Find(kinds[k], map[i].index);
+				const Region* r2 = pass == 0 ? map2.Find(kinds[k], map[i].index) : &map[i];
+				if (pass == 1 && r1 != NULL)
+					continue;		// pass 0 Ŕrς.
+				char prompt[100], pos1[30], pos2[30];
+				strcpy(pos1, "-----");
+				strcpy(pos2, "-----");
+				if (r1) sprintf(pos1, "+%08lX(%lu bytes)", (ulong)r1->offset, (ulong)r1->size);
+				if (r2) sprintf(pos2, "+%08lX(%lu bytes)", (ulong)r2->offset, (ulong)r2->size);
+				sprintf(prompt, "%s[%lu] %s <=> %s:", RegionKindString(kinds[k]), (ulong)map[i].index, pos1, pos2);
+				const uchar* p1 = r1 ? exe1.MappedAddress + r1->offset : NULL;
+				const uchar* p2 = r2 ? exe2.MappedAddress + r2->offset : NULL;
+				uchar* masked1 = NULL;
+				uchar* masked2 = NULL;
+				if (kinds[k] == REGION_HEADERS && (gIgnoreTimeStamp || gIgnoreCheckSum)) {
+					if (r1) p1 = masked1 = masked_headers(exe1, *r1);
+					if (r2) p2 = masked2 = masked_headers(exe2, *r2);
+				}
+				differ += diff_rawdata(prompt, p1, r1 ? r1->size : 0, p2, r2 ? r2->size : 0);
+				delete[] masked1;
+				delete[] masked2;
+			}
+		}
+	}
+	return differ;
+}
+
+/** ZNVf[^ubNnbVPʂŔr. ǂ炩XibvVbg̏ꍇɎg. */
+int diff_blocks(const char* prompt, const ExeFileImage& exe1, size_t i1, const ExeFileImage& exe2, size_t i2)
+{
+	size_t block = exe1.IsSnapshot() ? exe1.BlockSize() : exe2.BlockSize();
+	if (exe1.IsSnapshot() && exe2.IsSnapshot() && exe1.BlockSize() != exe2.BlockSize()) {
+		DIFFPRINTF(("\n%s\n\tblock size %lu <=> %lu, cannot compare.\n", prompt, (ulong)exe1.BlockSize(), (ulong)exe2.BlockSize()));
+		return 1;
+	}
+	size_t n1 = exe1.RawData(i1).size;
+	size_t n2 = exe2.RawData(i2).size;
+	size_t differ = 0;
+	for (size_t offset = 0; offset < n1 || offset < n2; offset += block) {
+		size_t len1 = offset < n1 ? min(block, n1 - offset) : 0;
+		size_t len2 = offset < n2 ? min(block, n2 - offset) : 0;
+		ulong h1 = len1 ? exe1.BlockHash(i1, offset, len1) : 0;
+		ulong h2 = len2 ? exe2.BlockHash(i2, offset, len2) : 0;
+
+		if (len1 == len2 && h1 == h2) continue;
+
+		if (differ == 0)
+			DIFFPRINTF(("\n%s\n", prompt));
+
+		if (++differ > gDiffLength) {
+			DIFFPRINTF(("\t<snip> differ more than %lu blocks.\n", (ulong)gDiffLength));
+			break;
+		}
+
+		if (len1 == 0)
+			DIFFPRINTF(("+%08lX: -------- <=> %08lX(%lu bytes)\n", (ulong)offset, h2, (ulong)len2));
+		else if (len2 == 0)
+			DIFFPRINTF(("+%08lX: %08lX(%lu bytes) <=> --------\n", (ulong)offset, h1, (ulong)len1));
+		else
+			DIFFPRINTF(("+%08lX: %08lX(%lu bytes) <=> %08lX(%lu bytes)\n", (ulong)offset, h1, (ulong)len1, h2, (ulong)len2));
+	}//.endfor
+	return differ != 0;
+}
+
+/** ̖OWr. ЕɂO < / > ŕ\. */
+int diff_names(const char* prompt, const NameSet& names1, const NameSet& names2)
+{
+	int differ = 0;
+	size_t i = 0, j = 0;
+	while (i < names1.Count() || j < names2.Count()) {
+		int cmp = (i >= names1.Count()) ? 1 : (j >= names2.Count()) ? -1 : strcmp(names1[i], names2[j]);
+		if (cmp == 0) {
+			++i; ++j;
+			continue;
+		}
+		if (differ++ == 0)
+			DIFFPRINTF(("\n%s:\n", prompt));
+		// DIFFPRINTF  -q Ȃ]Ȃ̂ŁAY̍XV͊Oɏ.
+		if (cmp < 0) {
+			DIFFPRINTF(("<%s\n", names1[i]));
+			++i;
+		}
+		else {
+			DIFFPRINTF((">%s\n", names2[j]));
+			++j;
+		}
+	}//.endwhile
+	return differ;
+}
+
+int diff(const ExeFileImage& exe1, const ExeFileImage& exe2)
+{
+	int differ = 0;
+
+	if (gDirDiff && !gQuiet)
+		printf("===== compare \"%s\" and \"%s\" =====\n", exe1.ModuleName, exe2.ModuleName);
+
+	// XibvVbgɋL^t@CŜCRC32ƈv΁AڂƂɔׂ܂łȂ.
+	if (exe1.MatchesSnapshot(exe2) || exe2.MatchesSnapshot(exe1)) {
+		printf("\"%s\" and \"%s\" are identical\n", exe1.ModuleName, exe2.ModuleName);
+		return 0;
+	}
+
+	differ += diff_header("FileHeader", exe1.FileHeader->FileHeader, exe2.FileHeader->FileHeader);
+
+	differ += diff_header("OptionalHeader", exe1.FileHeader->OptionalHeader, exe2.FileHeader->OptionalHeader);
+
+	for (size_t i = 0; i < exe1.NumberOfSections || i < exe2.NumberOfSections; ++i) {
+		char prompt[100];
+		char name1[IMAGE_SIZEOF_SHORT_NAME + 1];
+		char name2[IMAGE_SIZEOF_SHORT_NAME + 1];
+
+		// ЕɂZNV́AЕ̃ZNV\QƂOɏ.
+		if (i >= exe1.NumberOfSections) {
+			printf("%s section is only in \"%s\"\n", SectionNameString(exe2.Sections[i].Name), exe2.ModuleName); ++differ; continue;
+		}
+		if (i >= exe2.NumberOfSections) {
+			printf("%s section is only in \"%s\"\n", SectionNameString(exe1.Sections[i].Name), exe1.ModuleName); ++differ; continue;
+		}
+		const IMAGE_SECTION_HEADER& sec1 = exe1.Sections[i];
+		const IMAGE_SECTION_HEADER& sec2 = exe2.Sections[i];
+		sprintf(prompt, "Section Header[%lu]", (ulong)i+1);
+		differ += diff_header(prompt, sec1, sec2);
+
+		sprintf(prompt, "Section RawData[%lu] %s <=> %s:", (ulong)i+1, SectionNameString(sec1.Name, name1), SectionNameString(sec2.Name, name2));
+		if (exe1.IsSnapshot() || exe2.IsSnapshot())
+			differ += diff_blocks(prompt, exe1, i, exe2, i);
+		else if (diff_rawdata(prompt,
+				exe1.RawData(i).data, exe1.RawData(i).size,
+				exe2.RawData(i).data, exe2.RawData(i).size)) {
+			++differ;
+			// -e ȂAω̂kEÍf[^AR[h\悤zׂ.
+			if (gProfile) {
+				sprintf(prompt, "Section Profile[%lu] %s <=> %s:", (ulong)i+1, name1, name2);
+				diff_profile(prompt,
+					exe1.RawData(i).data, exe1.RawData(i).size,
+					exe2.RawData(i).data, exe2.RawData(i).size);
+			}
+		}
+	}//.endfor
+
+	// -a ȂA\PʂŔrȂc̗̈oCgƂĔr. XibvVbgɂ͂̓e.
+	if (gCompareAll && !exe1.IsSnapshot() && !exe2.IsSnapshot())
+		differ += diff_regions(exe1, exe2);
+
+	// XibvVbgɂ̓ZNVf[^̂ŁAGNX|[g/C|[g\ƂĔr.
+	if (exe1.IsSnapshot() || exe2.IsSnapshot()) {
+		NameSet exports1, exports2, imports1, imports2;
+		exe1.GetExports(exports1);
+		exe2.GetExports(exports2);
+		differ += diff_names("Exports", exports1, exports2);
+		exe1.GetImports(imports1);
+		exe2.GetImports(imports2);
+		differ += diff_names("Imports", imports1, imports2);
 	}
+
+	if (differ != 0)
+		printf("\"%s\" and \"%s\" differ\n",        exe1.ModuleName, exe2.ModuleName);
+	else
+		printf("\"%s\" and \"%s\" are identical\n", exe1.ModuleName, exe2.ModuleName);
+
+	return differ;
 }
 
-int diff_header(const char* prompt, const IMAGE_OPTIONAL_HEADER& opt1, const IMAGE_OPTIONAL_HEADER& opt2)
+/** --brief ̔. diff ƓڂÂׂ珇ɒׁAŏ̍قőł؂.
+ * 傫Awb_AZNVf[^(XibvVbgȂubNnbV)̏.
+ */
+bool brief_differ(const ExeFileImage& exe1, const ExeFileImage& exe2)
 {
-	int differ = 0;
-	DIFFWORD(opt, Magic);
-	DIFFVER (opt, LinkerVersion);
-	DIFFLONG(opt, SizeOfCode);
-	DIFFLONG(opt, SizeOfInitializedData);
-	DIFFLONG(opt, SizeOfUninitializedData);
-	DIFFLONG(opt, AddressOfEntryPoint);
-	DIFFLONG(opt, BaseOfCode);
-	DIFFLONG(opt, BaseOfData);
-	DIFFLONG(opt, ImageBase);
-	DIFFLONG(opt, SectionAlignment);
-	DIFFLONG(opt, FileAlignment);
-	DIFFVER (opt, OperatingSystemVersion);
-	DIFFVER (opt, ImageVersion);
-	DIFFVER (opt, SubsystemVersion);
-	DIFFLONG(opt, Win32VersionValue);
-	DIFFLONG(opt, SizeOfImage);
-	DIFFLONG(opt, SizeOfHeaders);
-	if (!gIgnoreCheckSum) { DIFFLONG(opt, CheckSum); }
-	DIFFSTRF(opt, Subsystem, SubsystemString);
-	DIFFWORD(opt, DllCharacteristics);
-	DIFFLONG(opt, SizeOfStackReserve);
-	DIFFLONG(opt, SizeOfStackCommit);
-	DIFFLONG(opt, SizeOfHeapReserve);
-	DIFFLONG(opt, SizeOfHeapCommit);
-	DIFFLONG(opt, LoaderFlags);
-	DIFFLONG(opt, NumberOfRvaAndSizes);
+	const bool snapshot = exe1.IsSnapshot() || exe2.IsSnapshot();
+	if (snapshot && (exe1.MatchesSnapshot(exe2) || exe2.MatchesSnapshot(exe1)))
+		return false;
 
-/** @todo differ Rva,Size */
-//	printf("----- Rva, Size -----\n");
-//	for (size_t i = 0; i < opt.NumberOfRvaAndSizes; ++i) {
-//		const IMAGE_DATA_DIRECTORY& d = opt.DataDirectory[i];
-//		printf("%20s[%2u] : %08X, %08X\n", "DataDirectory", i, d.VirtualAddress, d.Size);
-//	}
+	// 傫. -a Ȃt@CŜRȂr̂ŁAt@C̈Ⴂ͕Kǂ̍قɂȂ.
+	if (exe1.NumberOfSections != exe2.NumberOfSections)
+		return true;
+	if (gCompareAll && !snapshot && exe1.SizeOfImage != exe2.SizeOfImage)
+		return true;
+	for (size_t i = 0; i < exe1.NumberOfSections; ++i) {
+		if (exe1.RawData(i).size != exe2.RawData(i).size)
+			return true;
+	}
+
+	// wb_.
+	if (diff_header("FileHeader", exe1.FileHeader->FileHeader, exe2.FileHeader->FileHeader)
+	 || diff_header("OptionalHeader", exe1.FileHeader->OptionalHeader, exe2.FileHeader->OptionalHeader))
+		return true;
+	for (size_t i = 0; i < exe1.NumberOfSections; ++i) {
+		if (diff_header("Section Header", exe1.Sections[i], exe2.Sections[i]))
+			return true;
+	}
+
+	// ZNVf[^.
+	for (size_t i = 0; i < exe1.NumberOfSections; ++i) {
+		if (snapshot ? diff_blocks("", exe1, i, exe2, i) : !equal_bytes(exe1.RawData(i).data, exe2.RawData(i).data, exe1.RawData(i).size))
+			return true;
+	}
+
+	if (gCompareAll && !snapshot && diff_regions(exe1, exe2))
+		return true;
+
+	if (snapshot) {
+		NameSet exports1, exports2, imports1, imports2;
+		exe1.GetExports(exports1);
+		exe2.GetExports(exports2);
+		if (diff_names("Exports", exports1, exports2))
+			return true;
+		exe1.GetImports(imports1);
+		exe2.GetImports(imports2);
+		if (diff_names("Imports", imports1, imports2))
+			return true;
+	}
+	return false;
+}
+
+/** --brief ̔r. v/sv1s\. */
+int brief_diff(const ExeFileImage& exe1, const ExeFileImage& exe2)
+{
+	bool differ = brief_differ(exe1, exe2);
+	if (differ)
+		printf("\"%s\" and \"%s\" differ\n",        exe1.ModuleName, exe2.ModuleName);
+	else
+		printf("\"%s\" and \"%s\" are identical\n", exe1.ModuleName, exe2.ModuleName);
 	return differ;
 }
 
-void dump_header(const IMAGE_SECTION_HEADER& sec)
+
+//------------------------------------------------------------------------
+/** ǂݍ񂾃C[WLRULbV.
+ * t@CJԂrꍇɁA}bv⏑ɂ̐L蒼Ȃ.
+ * gpłȂC[WÂɎ̂ĂāAvTCY\Zɕۂ.
+ * ǂݍ݌Ƀt@CĂAǂݍݒ.
+ */
+class ImageCache {
+	struct Entry {
+		char* path;			///< KpX. Ƀo[Ȃ珑ɖ𐳋K.
+		ExeFileImage* image;
+		FileStamp stamp;	///< ǂݍݎ̃t@C(Ƀo[Ȃ珑)̑傫ƍXV.
+		size_t refs;		///< Acquire  Release ĂȂ.
+		Entry* prev;		///< ŋ߂Ɏgꂽ.
+		Entry* next;		///< Â.
+	};
+	Entry* mHead;			///< łŋ߂Ɏgꂽ.
+	Entry* mTail;			///< łÂ.
+	size_t mBytes;
+	size_t mBudget;
+	ImageCache(const ImageCache&);		// don't copy
+	void operator=(const ImageCache&);	// don't assign
+
+	void unlink(Entry* e);
+	void push_front(Entry* e);
+	void drop(Entry* e);
+	void evict();
+	static void identify(const char* path, char* key, FileStamp& stamp);
+public:
+	/** @param budget	ێC[W̍vTCY̏(oCg). */
+	ImageCache(size_t budget) : mHead(NULL), mTail(NULL), mBytes(0), mBudget(budget) {}
+
+	~ImageCache();
+
+	/** path̃C[W𓾂. ǂݍ߂ȂNULLԂAGetLastError()ɗRc.
+	 * gI Release 邱. ܂ł̓LbV̂ĂȂ.
+	 */
+	ExeFileImage* Acquire(const char* path);
+
+	/** Acquire œC[W̎gpI. */
+	void Release(const ExeFileImage* image);
+};
+
+ImageCache::~ImageCache()
 {
-	PRINTSTR(sec, Name);
-	PRINTLONG(sec.Misc, VirtualSize);
-	PRINTLONG(sec, VirtualAddress);
-	PRINTLONG(sec, SizeOfRawData);
-	PRINTLONG(sec, PointerToRawData);
-	PRINTLONG(sec, PointerToRelocations);
-	PRINTLONG(sec, PointerToLinenumbers);
-	PRINTWORD(sec, NumberOfRelocations);
-	PRINTWORD(sec, NumberOfLinenumbers);
-	PRINTSTRF(sec, Characteristics, SectionCharacteristicsString);
+	while (mHead != NULL) {
+		Entry* e = mHead;
+		mHead = e->next;
+		delete e->image;
+		free(e->path);
+		delete e;
+	}
 }
 
-int diff_header(const char* prompt, const IMAGE_SECTION_HEADER& sec1, const IMAGE_SECTION_HEADER& sec2)
+void ImageCache::unlink(Entry* e)
 {
-	// DIFF}Ng߂̌떂.
-	struct {
-		DWORD VirtualSize;
-	} misc1, misc2;
-	misc1.VirtualSize = sec1.Misc.VirtualSize;
-	misc2.VirtualSize = sec2.Misc.VirtualSize;
+	(e->prev ? e->prev->next : mHead) = e->next;
+	(e->next ? e->next->prev : mTail) = e->prev;
+	e->prev = e->next = NULL;
+}
 
-	int differ = 0;
-	DIFFSTR(sec, Name);
-	DIFFLONG(misc, VirtualSize);
-	DIFFLONG(sec, VirtualAddress);
-	DIFFLONG(sec, SizeOfRawData);
-	DIFFLONG(sec, PointerToRawData);
-	DIFFLONG(sec, PointerToRelocations);
-	DIFFLONG(sec, PointerToLinenumbers);
-	DIFFWORD(sec, NumberOfRelocations);
-	DIFFWORD(sec, NumberOfLinenumbers);
-	DIFFSTRF(sec, Characteristics, SectionCharacteristicsString);
-	return differ;
+void ImageCache::push_front(Entry* e)
+{
+	e->prev = NULL;
+	e->next = mHead;
+	(mHead ? mHead->prev : mTail) = e;
+	mHead = e;
 }
 
-void dump_rawdata(const UCHAR* prompt, const UCHAR* p, size_t n)
+/** gpłȂڂ̂Ă. */
+void ImageCache::drop(Entry* e)
 {
-	const UCHAR* b = p;
-	char dump[16*3+1];
-	char asc[16+1];
-	size_t i = 0, j = 0;
-	while (j < n) {
-		int c = p[j++];
-		sprintf(dump + i*3, "%02X%c", c, i==7 ? '-' : ' ');
-		asc[i] = ascii(c);
-		if (++i >= 16) {
-			asc[16] = 0;
-			printf("%14s +%p : %-48s:%-16s\n", prompt, j-i, dump, asc);
-			i = 0;
+	unlink(e);
+	mBytes -= e->image->SizeOfImage;
+	delete e->image;
+	free(e->path);
+	delete e;
+}
+
+void ImageCache::evict()
+{
+	Entry* e = mTail;
+	while (mBytes > mBudget && e != NULL) {
+		Entry* prev = e->prev;
+		if (e->refs == 0)
+			drop(e);
+		e = prev;
+	}
+}
+
+/** pathTƁAo𓾂.
+ * 풓[hł͗vƂɍƃtH_ς̂ŁA͍ƃtH_Ɉ˂ȂKpXƂ.
+ * ȊOpatĥ܂. KłȂpatĥ܂.
+ * Ƀo[Ȃ珑ɖ𐳋KA͏ɂ̂̂Ƃ. 󂪓Ȃ0Ƃ.
+ * @param key	̊i[. _MAX_PATH * 2 oCgȏ.
+ */
+void ImageCache::identify(const char* path, char* key, FileStamp& stamp)
+{
+	char archive[_MAX_PATH];
+	const char* member = separate_archive_member(path, archive);
+	const char* file = member ? archive : path;
+	bool full = false;
+	if (gServing) {
+#ifdef _WIN32
+		full = _fullpath(key, file, _MAX_PATH) != NULL;
+#else
+		full = realpath(file, key) != NULL;
+#endif
+	}
+	if (!full)
+		_snprintf(key, _MAX_PATH, "%s", file);
+	if (member)
+		_snprintf(key + strlen(key), _MAX_PATH, "!%s", member);
+	if (!get_file_stamp(file, stamp))
+		stamp.size = stamp.mtime = 0;
+}
+
+ExeFileImage* ImageCache::Acquire(const char* path)
+{
+	char key[_MAX_PATH * 2];
+	FileStamp stamp;
+	identify(path, key, stamp);
+	for (Entry* e = mHead; e != NULL; e = e->next) {
+		if (!strequ(e->path, key))
+			continue;
+		if (!(e->stamp == stamp)) {
+			// Ă. gpłȂΎ̂āAÂe͎g킸ɓǂݍݒ.
+			if (e->refs == 0)
+				drop(e);
+			break;
+		}
+		unlink(e);
+		push_front(e);
+		if (e->refs == 0)
+			e->image->Rename(path);		// \͍̒Ԃɍ킹.
+		++e->refs;
+		return e->image;
+	}
+	ExeFileImage* image = new ExeFileImage(path);
+	if (!image->IsLoaded()) {
+		DWORD win32error = ::GetLastError();
+		delete image;
+		::SetLastError(win32error);
+		return NULL;
+	}
+	Entry* e = new Entry;
+	e->path = _strdup(key);
+	e->image = image;
+	e->stamp = stamp;
+	e->refs = 1;
+	push_front(e);
+	mBytes += image->SizeOfImage;
+	evict();
+	return image;
+}
+
+void ImageCache::Release(const ExeFileImage* image)
+{
+	for (Entry* e = mHead; e != NULL; e = e->next) {
+		if (e->image == image) {
+			--e->refs;
+			break;
+		}
+	}
+	evict();
+}
+
+/** rɎgC[WLbV. \Z -m# Ŏw肷. */
+ImageCache& image_cache()
+{
+	static ImageCache cache(gCacheBudget * 1024 * 1024);
+	return cache;
+}
+
+//------------------------------------------------------------------------
+/** t@C̐ǂ. fBNgrŁAɔrt@CI/O݂̔rƕsĐi߂.
+ * ƃXbh˗ꂽt@CJAWin32ł͓ǂݎ̂ĂăVXeLbVɍڂ.
+ * POSIXł posix_fadvise(POSIX_FADV_WILLNEED) ŃJ[lɐǂ݂˗.
+ * pX̉ǂ݂̔ső҂͍̂ƃXbhŁAr鑤̃Xbh͑҂Ȃ.
+ * ƃXbh͍ŏ̈˗ŋN̂ŁA-p0 ⏑ɂǂ̔rł̓XbhȂ.
+ * (imagehlp ̓XbhZ[tłȂ̂ŁAƃXbhł̓}bvȂ.)
+ */
+class Prefetcher {
+	enum { QUEUE_SIZE = 64 };
+	char* mQueue[QUEUE_SIZE];	///< ǂݑ҂̃pX. Oobt@.
+	size_t mHead;
+	size_t mCount;
+	bool mStop;
+	bool mStarted;				///< ƃXbhĂ.
+	bool mFailed;				///< ƃXbhNȂ. Ȍ͐ǂ݂Ȃ.
+#ifdef _WIN32
+	CRITICAL_SECTION mLock;
+	HANDLE mWakeup;				///< ҂\Z}tH.
+	HANDLE mThread;
+
+	static DWORD WINAPI thread_proc(void* self);
+#else
+	pthread_mutex_t mLock;
+	pthread_cond_t mWakeup;		///< ҂A~˗ꂽ.
+	pthread_t mThread;
+
+	static void* thread_proc(void* self);
+#endif
+	void run();
+
+	/** ƃXbhN. s false. */
+	bool start();
+
+	/** ҂s񂩂1o. ~˗ꂽ NULL Ԃ. */
+	char* next();
+
+	/** pathǂ݂. */
+	static void prefetch(const char* path);
+
+	Prefetcher(const Prefetcher&);		// don't copy
+	void operator=(const Prefetcher&);	// don't assign
+public:
+	Prefetcher();
+
+	~Prefetcher();
+
+	/** path̐ǂ݂˗. sĂȂ. */
+	void Request(const char* path);
+};
+
+#ifdef _WIN32
+Prefetcher::Prefetcher()
+	: mHead(0), mCount(0), mStop(false), mStarted(false), mFailed(false), mWakeup(NULL), mThread(NULL)
+{
+	::InitializeCriticalSection(&mLock);
+}
+
+bool Prefetcher::start()
+{
+	mWakeup = ::CreateSemaphore(NULL, 0, QUEUE_SIZE + 1, NULL);
+	if (mWakeup != NULL)
+		mThread = ::CreateThread(NULL, 0, thread_proc, this, 0, NULL);
+	mStarted = mThread != NULL;
+	mFailed = !mStarted;
+	return mStarted;
+}
+
+Prefetcher::~Prefetcher()
+{
+	if (mStarted) {
+		::EnterCriticalSection(&mLock);
+		mStop = true;
+		::LeaveCriticalSection(&mLock);
+		::ReleaseSemaphore(mWakeup, 1, NULL);
+		::WaitForSingleObject(mThread, INFINITE);
+		::CloseHandle(mThread);
+	}
+	if (mWakeup != NULL)
+		::CloseHandle(mWakeup);
+	for (; mCount != 0; --mCount, mHead = (mHead + 1) % QUEUE_SIZE)
+		free(mQueue[mHead]);
+	::DeleteCriticalSection(&mLock);
+}
+
+void Prefetcher::Request(const char* path)
+{
+	if (!mStarted && (mFailed || !start()))
+		return;
+	bool queued = false;
+	::EnterCriticalSection(&mLock);
+	if (mCount < QUEUE_SIZE) {		// ꂽǂ݂߂.
+		mQueue[(mHead + mCount) % QUEUE_SIZE] = _strdup(path);
+		++mCount;
+		queued = true;
+	}
+	::LeaveCriticalSection(&mLock);
+	if (queued)
+		::ReleaseSemaphore(mWakeup, 1, NULL);
+}
+
+DWORD WINAPI Prefetcher::thread_proc(void* self)
+{
+	static_cast<Prefetcher*>(self)->run();
+	return 0;
+}
+
+char* Prefetcher::next()
+{
+	for (;;) {
+		::WaitForSingleObject(mWakeup, INFINITE);
+		::EnterCriticalSection(&mLock);
+		char* path = NULL;
+		if (!mStop && mCount != 0) {
+			path = mQueue[mHead];
+			mHead = (mHead + 1) % QUEUE_SIZE;
+			--mCount;
+		}
+		bool stop = mStop;
+		::LeaveCriticalSection(&mLock);
+		if (stop || path != NULL)
+			return path;
+	}
+}
+
+void Prefetcher::prefetch(const char* path)
+{
+	static char buf[64*1024];		// ǂݎ̂ėp. ƃXbh1.
+	HANDLE h = ::CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (h != INVALID_HANDLE_VALUE) {
+		DWORD n;
+		while (::ReadFile(h, buf, sizeof(buf), &n, NULL) && n != 0)
+			;
+		::CloseHandle(h);
+	}
+}
+#else
+Prefetcher::Prefetcher()
+	: mHead(0), mCount(0), mStop(false), mStarted(false), mFailed(false)
+{
+	pthread_mutex_init(&mLock, NULL);
+	pthread_cond_init(&mWakeup, NULL);
+}
+
+bool Prefetcher::start()
+{
+	mStarted = pthread_create(&mThread, NULL, thread_proc, this) == 0;
+	mFailed = !mStarted;
+	return mStarted;
+}
+
+Prefetcher::~Prefetcher()
+{
+	if (mStarted) {
+		pthread_mutex_lock(&mLock);
+		mStop = true;
+		pthread_cond_signal(&mWakeup);
+		pthread_mutex_unlock(&mLock);
+		pthread_join(mThread, NULL);
+	}
+	for (; mCount != 0; --mCount, mHead = (mHead + 1) % QUEUE_SIZE)
+		free(mQueue[mHead]);
+	pthread_cond_destroy(&mWakeup);
+	pthread_mutex_destroy(&mLock);
+}
+
+void Prefetcher::Request(const char* path)
+{
+	if (!mStarted && (mFailed || !start()))
+		return;
+	pthread_mutex_lock(&mLock);
+	if (mCount < QUEUE_SIZE) {		// ꂽǂ݂߂.
+		mQueue[(mHead + mCount) % QUEUE_SIZE] = strdup(path);
+		++mCount;
+		pthread_cond_signal(&mWakeup);
+	}
+	pthread_mutex_unlock(&mLock);
+}
+
+void* Prefetcher::thread_proc(void* self)
+{
+	static_cast<Prefetcher*>(self)->run();
+	return NULL;
+}
+
+char* Prefetcher::next()
+{
+	pthread_mutex_lock(&mLock);
+	while (!mStop && mCount == 0)
+		pthread_cond_wait(&mWakeup, &mLock);
+	char* path = NULL;
+	if (!mStop) {
+		path = mQueue[mHead];
+		mHead = (mHead + 1) % QUEUE_SIZE;
+		--mCount;
+	}
+	pthread_mutex_unlock(&mLock);
+	return path;
+}
+
+void Prefetcher::prefetch(const char* path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return;
+	posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+	close(fd);
+}
+#endif
+
+void Prefetcher::run()
+{
+	char* path;
+	while ((path = next()) != NULL) {
+		prefetch(path);
+		free(path);
+	}
+}
+
+//------------------------------------------------------------------------
+/** [hC[Wrs.
+ * @retval 0 v
+ * @retval 1 sv
+ */
+int Compare(const ExeFileImage& f1, const ExeFileImage& f2)
+{
+	if (gDumpFileImage) {
+		f1.print();
+		f2.print();
+	}
+	return (gBrief ? brief_diff(f1, f2) : diff(f1, f2)) != 0;
+}
+
+/** [hC[Wrs.
+ * @retval 0 v
+ * @retval 1 sv
+ * @retval 2 t@Cǂݍݎs
+ */
+int Compare(const char* fname1, const char* fname2)
+{
+	// Ƀo[ȂAfBNgCRC32ƃTCYv̂͐LɈvƂ.
+	if (!gDumpFileImage) {
+		const ZipArchive* zip1;
+		const ZipArchive* zip2 = NULL;
+		const ZipArchive::Member* m1 = FindArchiveMember(fname1, zip1);
+		const ZipArchive::Member* m2 = m1 ? FindArchiveMember(fname2, zip2) : NULL;
+		const bool same = m1 != NULL && m2 != NULL && m1->crc == m2->crc && m1->size == m2->size;
+		CloseArchive(zip1);
+		CloseArchive(zip2);
+		if (same) {
+			if (gDirDiff && !gQuiet)
+				printf("===== compare \"%s\" and \"%s\" =====\n", fname1, fname2);
+			printf("\"%s\" and \"%s\" are identical\n", fname1, fname2);
+			return 0;
 		}
-	}//.endwhile
-	if (i != 0) {
-		asc[i] = 0;
-		printf("%14s +%p : %-48s:%-16s\n", prompt, j-i, dump, asc);
 	}
+	ImageCache& cache = image_cache();
+	ExeFileImage* f1 = cache.Acquire(fname1); if (f1 == NULL) { print_win32error(fname1); return 2; }
+	ExeFileImage* f2 = cache.Acquire(fname2); if (f2 == NULL) { print_win32error(fname2); cache.Release(f1); return 2; }
+	int ret = Compare(*f1, *f2);
+	cache.Release(f1);
+	cache.Release(f2);
+	return ret;
+}
+
+/** tH_܂͏ɂɂt@C̃pX. ɂȂ "ARCHIVE.zip!NAME" `ɂȂ. */
+void make_entry_path(char* path, const char* dir, bool archive, const char* name)
+{
+	if (strlen(dir) + strlen(name) + 2 > _MAX_PATH)
+		error_abort("too long pathname", name);
+	if (archive) {
+		strcpy(path, dir);
+		strcat(path, "!");
+		strcat(path, name);
+	}
+	else
+		_makepath(path, NULL, dir, name, NULL);
+}
+
+/** fBNgr1t@C̐ǂ݂˗. Ƀo[͏ɂ}bvς݂Ȃ̂őΏۊO.
+ * name1NULLȂADIR1ɂ͖̂Őǂ݂Ȃ.
+ */
+void PrefetchEntry(Prefetcher& prefetcher, const char* dir1, bool archive1, const char* name1, const char* dir2, bool archive2, const char* name2)
+{
+	char path[_MAX_PATH];
+	if (!archive1 && name1 != NULL) {
+		make_entry_path(path, dir1, archive1, name1);
+		prefetcher.Request(path);
+	}
+	if (!archive2) {
+		make_entry_path(path, dir2, archive2, name2);
+		prefetcher.Request(path);
+	}
+}
+
+/** fBNgr1t@C. DIR1݂͑Ȃ\. */
+int CompareEntry(const char* dir1, bool archive1, const char* name1, const char* dir2, bool archive2, const char* name2)
+{
+	char path1[_MAX_PATH];
+	char path2[_MAX_PATH];
+	make_entry_path(path1, dir1, archive1, name1);
+	make_entry_path(path2, dir2, archive2, name2);
+	return Compare(path1, path2);
+}
+
+/** fname2̃XibvVbgfname1ɏo.
+ * @retval 0 
+ * @retval 2 ǂݍ݂܂͏݂̎s
+ */
+int WriteSnapshot(const char* fname1, const char* fname2)
+{
+	ExeFileImage f2(fname2); if (!f2.IsLoaded()) { print_win32error(fname2); return 2; }
+	if (f2.IsSnapshot()) {
+		fprintf(stderr, "%s: already a snapshot\n", fname2);
+		return 2;
+	}
+	if (!f2.WriteSnapshot(fname1)) {
+		fprintf(stderr, "%s: %s\n", fname1, strerror(errno));
+		return 2;
+	}
+	if (!gQuiet)
+		printf("snapshot of \"%s\" is written to \"%s\"\n", fname2, fname1);
+	return 0;
+}
+
+/** fBNgPʂ̃XibvVbgo1t@C. */
+int WriteSnapshotEntry(const char* dir1, bool archive1, const char* name1, const char* dir2, bool archive2, const char* name2)
+{
+	char path1[_MAX_PATH];
+	char path2[_MAX_PATH];
+	make_entry_path(path1, dir1, archive1, name1);
+	make_entry_path(path2, dir2, archive2, name2);
+	return WriteSnapshot(path1, path2);
+}
+
+/** fBNg1t@Cs֐. CompareEntry ܂ WriteSnapshotEntry. */
+typedef int (*EntryProc)(const char* dir1, bool archive1, const char* name1, const char* dir2, bool archive2, const char* name2);
+
+/** ̃t@C(Ƀo[܂)w? tH_Əɂ̂̂͊܂܂Ȃ. */
+bool IsSingleFile(const char* spec)
+{
+	char archive[_MAX_PATH];
+	return (IsExistFile(spec) && !IsArchive(spec)) || separate_archive_member(spec, archive) != NULL;
 }
 
-int diff_rawdata(const char* prompt, const UCHAR* p1, size_t n1, const UCHAR* p2, size_t n2)
-{
-	size_t differ = 0;
-	for (size_t i = 0; i < n1 || i < n2; ++i) {
-		int c1 = (i < n1) ? p1[i] : -1;
-		int c2 = (i < n2) ? p2[i] : -1;
+//------------------------------------------------------------------------
+///@name ꂽt@C̑Ήt
+/// fBNgrœ̃t@ĈAe̗ގxőΉt.
+/// eC[W̓(ZNVf[^̃ubNnbVƁAGNX|[g/C|[g)̏W
+/// MinHashŌŒ蒷̗}ɂA}тɕǏsqnbV(LSH)ŌiĂގx߂.
+//@{
+/** }̒. ގx͈vvf̊ŁA1/SKETCH_SIZE PʂɂȂ. */
+const size_t SKETCH_SIZE = 64;
+
+/** LSH̑т̐. 1̑т SKETCH_SIZE / SKETCH_BANDS vf. ǂꂩ̑тSĈvΌɂ.
+ * 2vf32тȂAގx50%̑g99.99%A30%̑g95%̊mŌɂȂ.
+ */
+const size_t SKETCH_BANDS = 32;
 
-		if (c1 == c2) continue;
+/** 菭ȂubÑt@ĆAȂė}̗ގxĂɂȂȂ.
+ * n̂1ςΗގx (n-1)/(n+1) Ȃ̂ŁA1oCg̈Ⴂł50%.
+ * ̂悤ȃt@Cǂ́At@CŜoCgPʂŔׂގxg.
+ */
+const size_t SKETCH_MIN_BLOCKS = 4;
 
-		if (differ == 0)
-			DIFFPRINTF(("\n%s\n", prompt));
+/** C[W̓WMinHash}. */
+struct Sketch {
+	DWORD mins[SKETCH_SIZE];	///< nbV֐Ƃ́A̍ŏnbVl.
+	bool valid;					///< 1ȏ゠.
+	bool small;					///< SKETCH_MIN_BLOCKS ubN菬t@C.
+	size_t size;				///< t@CŜ̃TCY.
+	ulong crc;					///< t@CŜCRC32. small̏ꍇL.
+	uchar* bytes;				///< small̏ꍇ̃t@CŜ̕(malloc). XibvVbgȂNULL.
+};
 
-		if (++differ > gDiffLength) {
-			DIFFPRINTF(("\t<snip> differ more than %d bytes.\n", gDiffLength));
-			break;
-		}
+/** 32bitl̝a(MurmurHash3̍ŏIi). */
+inline DWORD mix32(DWORD h)
+{
+	h ^= h >> 16; h *= 0x85EBCA6B;
+	h ^= h >> 13; h *= 0xC2B2AE35;
+	h ^= h >> 16;
+	return h;
+}
 
-		if (c1 == -1)
-			DIFFPRINTF(("+%p: ----- <=> %02X(%c)\n", i, c2, ascii(c2)));
-		else if (c2 == -1)
-			DIFFPRINTF(("+%p: %02X(%c) <=> -----\n", i, c1, ascii(c1)));
-		else
-			DIFFPRINTF(("+%p: %02X(%c) <=> %02X(%c)\n", i, c1, ascii(c1), c2, ascii(c2)));
-	}//.endfor
-	return differ != 0;
+/** 1𗪐}ɉ. kԖڂ̃nbV֐́Aς mix32 Ƃ. */
+void sketch_add(Sketch& sk, DWORD feature)
+{
+	sk.valid = true;
+	for (size_t k = 0; k < SKETCH_SIZE; ++k) {
+		DWORD h = mix32(feature ^ mix32((DWORD)k + 1));
+		if (h < sk.mins[k])
+			sk.mins[k] = h;
+	}
 }
 
-DWORD size_of_rawdata(const IMAGE_SECTION_HEADER& sec)
+void sketch_add_names(Sketch& sk, const NameSet& names)
 {
-	return min(sec.Misc.VirtualSize, sec.SizeOfRawData);
+	for (size_t i = 0; i < names.Count(); ++i)
+		sketch_add(sk, crc32(0, (const uchar*)names[i], strlen(names[i])));
 }
 
-void ExeFileImage::print() const
+/** C[W̗}. XibvVbgubNŋL^Ă΁Ãt@CƓ}ɂȂ. */
+void ComputeSketch(const ExeFileImage& exe, Sketch& sk)
 {
-	printf("===== dump of \"%s\" =====\n", ModuleName);
-	PRINTLONG(*FileHeader, Signature);
+	memset(sk.mins, 0xFF, sizeof(sk.mins));
+	sk.valid = false;
+	size_t block = exe.IsSnapshot() ? exe.BlockSize() : gSnapshotBlockSize;
+	sk.size = exe.FileSize();
+	sk.small = sk.size < SKETCH_MIN_BLOCKS * block;
+	sk.crc = sk.small ? exe.FileCrc() : 0;
+	sk.bytes = NULL;
+	if (sk.small && !exe.IsSnapshot()) {
+		sk.bytes = (uchar*)malloc(sk.size + 1);
+		if (sk.bytes == NULL)
+			error_abort("out of memory\n");
+		memcpy(sk.bytes, exe.MappedAddress, sk.size);
+	}
+	for (size_t i = 0; i < exe.NumberOfSections; ++i) {
+		size_t n = exe.RawData(i).size;
+		for (size_t offset = 0; offset < n; offset += block)
+			sketch_add(sk, exe.BlockHash(i, offset, min(block, n - offset)));
+	}
+	NameSet exports, imports;
+	exe.GetExports(exports);
+	exe.GetImports(imports);
+	sketch_add_names(sk, exports);
+	sketch_add_names(sk, imports);
+}
 
-	printf("----- FileHeader -----\n");
-	dump_header(FileHeader->FileHeader);
+/** }̗ގx(vvf̕S). ̓WJaccardW̐lɂȂ. */
+size_t sketch_similarity(const Sketch& sk1, const Sketch& sk2)
+{
+	size_t same = 0;
+	for (size_t k = 0; k < SKETCH_SIZE; ++k) {
+		if (sk1.mins[k] == sk2.mins[k])
+			++same;
+	}
+	return same * 100 / SKETCH_SIZE;
+}
 
-	printf("----- OptionalHeader -----\n");
-	dump_header(FileHeader->OptionalHeader);
+/** ̑ΉtɎgގx. ǂ炩ȃt@CȂA}ł͂Ȃt@CŜŔׂ.
+ * eΓʒüvoCg̊AXibvVbgȂTCYCRC32v100%Ƃ.
+ */
+size_t rename_similarity(const Sketch& sk1, const Sketch& sk2)
+{
+	if (!sk1.small && !sk2.small)
+		return sketch_similarity(sk1, sk2);
+	if (sk1.small && sk2.small && sk1.size == sk2.size && sk1.crc == sk2.crc)
+		return 100;
+	if (sk1.bytes == NULL || sk2.bytes == NULL)
+		return sketch_similarity(sk1, sk2);
+	const size_t n = min(sk1.size, sk2.size);
+	size_t same = 0;
+	for (size_t i = 0; i < n; ++i) {
+		if (sk1.bytes[i] == sk2.bytes[i])
+			++same;
+	}
+	return same * 100 / max(sk1.size, sk2.size);
+}
 
-	for (size_t i = 0; i < NumberOfSections; ++i) {
-		const IMAGE_SECTION_HEADER& sec = Sections[i];
+/** }bԖڂ̑т̃L[. */
+DWORD sketch_band(const Sketch& sk, size_t b)
+{
+	const size_t rows = SKETCH_SIZE / SKETCH_BANDS;
+	return crc32((ulong)b, (const uchar*)&sk.mins[b * rows], rows * sizeof(DWORD));
+}
 
-		printf("----- Section Header[%u] -----\n", i+1);
-		dump_header(sec);
+/** LSH1. т̃L[Ő񂷂. */
+struct BandEntry {
+	DWORD key;
+	size_t id;
+};
 
-		printf("----- Section RawData[%u] (BaseAddress:%p, Size:%d bytes) -----\n", i+1,
-			FileHeader->OptionalHeader.ImageBase + sec.VirtualAddress, sec.Misc.VirtualSize);
-		dump_rawdata(sec.Name,   MappedAddress + sec.PointerToRawData, size_of_rawdata(sec));
-	}
+int compare_bands(const void* a, const void* b)
+{
+	DWORD k1 = ((const BandEntry*)a)->key;
+	DWORD k2 = ((const BandEntry*)b)->key;
+	return k1 < k2 ? -1 : k1 > k2 ? 1 : 0;
 }
 
-int diff(const ExeFileImage& exe1, const ExeFileImage& exe2)
+/** Ήť. ގx̍ɐ񂷂. */
+struct RenamePair {
+	size_t similarity;
+	size_t i2;		///< entries ̓Y.
+	size_t j1;		///< DIR1̓Y.
+};
+
+/** Ήť. */
+void add_rename_pair(RenamePair*& pairs, size_t& npairs, size_t& capacity, size_t similarity, size_t i2, size_t j1)
 {
-	int differ = 0;
+	if (npairs == capacity) {
+		capacity = capacity ? capacity * 2 : 64;
+		pairs = (RenamePair*)realloc(pairs, capacity * sizeof(RenamePair));
+		if (pairs == NULL)
+			error_abort("out of memory\n");
+	}
+	pairs[npairs].similarity = similarity;
+	pairs[npairs].i2 = i2;
+	pairs[npairs].j1 = j1;
+	++npairs;
+}
 
-	if (gDirDiff && !gQuiet)
-		printf("===== compare \"%s\" and \"%s\" =====\n", exe1.ModuleName, exe2.ModuleName);
+int compare_rename_pairs(const void* a, const void* b)
+{
+	const RenamePair& p1 = *(const RenamePair*)a;
+	const RenamePair& p2 = *(const RenamePair*)b;
+	if (p1.similarity != p2.similarity)
+		return p1.similarity > p2.similarity ? -1 : 1;
+	if (p1.i2 != p2.i2)
+		return p1.i2 < p2.i2 ? -1 : 1;
+	return p1.j1 < p2.j1 ? -1 : p1.j1 > p2.j1 ? 1 : 0;
+}
 
-	differ += diff_header("FileHeader", exe1.FileHeader->FileHeader, exe2.FileHeader->FileHeader);
+/** ǂݍ߂C[W̗}. ǂݍ߂ȂΖȗ}ɂȂ. */
+void LoadSketch(const char* dir, bool archive, const char* name, Sketch& sk)
+{
+	char path[_MAX_PATH];
+	make_entry_path(path, dir, archive, name);
+	ImageCache& cache = image_cache();
+	ExeFileImage* exe = cache.Acquire(path);
+	sk.valid = false;
+	sk.small = false;
+	sk.bytes = NULL;
+	if (exe == NULL)
+		return;
+	ComputeSketch(*exe, sk);
+	cache.Release(exe);
+}
 
-	differ += diff_header("OptionalHeader", exe1.FileHeader->OptionalHeader, exe2.FileHeader->OptionalHeader);
+/** őΉtȂDIR2̃t@CADIR1̑Ήt@Ĉł̂ƑΉt.
+ * ގx -r# ȏ̑gAގx̍11Ō߂.
+ * @param list1		DIR1̑St@C.
+ * @param entries	DIR2̔rΏۂ̃t@C.
+ * @param names1	[in/out] entries[i]ɑΉDIR1̖O. NULL̂̂Ήt疄߂.
+ */
+void MatchRenamed(const char* dir1, bool archive1, const NameSet& list1,
+	const char* dir2, bool archive2, const NameSet& entries, const char** names1, const char* wild)
+{
+	// DIR1̌: ̑ΉɎgĂȂAWILD ɍvt@C.
+	NameIndex used1;
+	for (size_t i = 0; i < entries.Count(); ++i) {
+		if (names1[i] != NULL)
+			used1.Add(names1[i]);
+	}
+	WildPattern pattern(wild);
+	NameSet cand1;
+	for (size_t j = 0; j < list1.Count(); ++j) {
+		if (!used1.Find(list1[j]) && pattern.Match(list1[j]))
+			cand1.AddRef(list1[j]);
+	}
+	size_t n2 = 0;
+	for (size_t i = 0; i < entries.Count(); ++i) {
+		if (names1[i] == NULL)
+			++n2;
+	}
+	if (cand1.Count() == 0 || n2 == 0)
+		return;
 
-	for (size_t i = 0; i < exe1.NumberOfSections || i < exe2.NumberOfSections; ++i) {
-		const IMAGE_SECTION_HEADER& sec1 = exe1.Sections[i];
-		const IMAGE_SECTION_HEADER& sec2 = exe2.Sections[i];
-		char prompt[100];
+	// DIR1̗}ŁAтƂLSH. ȃt@C͑тĂɂȂȂ̂ŕʂɕׂ.
+	Sketch* sk1 = new Sketch[cand1.Count()];
+	BandEntry* bands = new BandEntry[cand1.Count() * SKETCH_BANDS];
+	size_t* small1 = new size_t[cand1.Count()];
+	size_t nbands = 0, nsmall1 = 0;
+	for (size_t j = 0; j < cand1.Count(); ++j) {
+		LoadSketch(dir1, archive1, cand1[j], sk1[j]);
+		if (!sk1[j].valid)
+			continue;
+		if (sk1[j].small)
+			small1[nsmall1++] = j;
+		for (size_t b = 0; b < SKETCH_BANDS; ++b) {
+			bands[nbands].key = sketch_band(sk1[j], b);
+			bands[nbands].id = j;
+			++nbands;
+		}
+	}
+	qsort(bands, nbands, sizeof(BandEntry), compare_bands);
 
-		if (i >= exe1.NumberOfSections) {
-			printf("%s section is only in \"%s\"\n", sec2.Name, exe2.ModuleName); ++differ; continue;
+	// DIR2̊et@CɂāAтv₾ގx߂.
+	// ȃt@ĆADIR1̏ȃt@CSĂƔׂ.
+	RenamePair* pairs = NULL;
+	size_t npairs = 0, capacity = 0;
+	size_t* seen = new size_t[cand1.Count()];		// ̏d߁AŌɒׂDIR2̓Y+1.
+	memset(seen, 0, cand1.Count() * sizeof(size_t));
+	for (size_t i = 0; i < entries.Count(); ++i) {
+		if (names1[i] != NULL)
+			continue;
+		Sketch sk2;
+		LoadSketch(dir2, archive2, entries[i], sk2);
+		if (!sk2.valid) {
+			free(sk2.bytes);
+			continue;
 		}
-		if (i >= exe2.NumberOfSections) {
-			printf("%s section is only in \"%s\"\n", sec1.Name, exe1.ModuleName); ++differ; continue;
+		for (size_t k = 0; sk2.small && k < nsmall1; ++k) {
+			size_t j = small1[k];
+			seen[j] = i + 1;
+			size_t similarity = rename_similarity(sk1[j], sk2);
+			if (similarity >= gRenameThreshold)
+				add_rename_pair(pairs, npairs, capacity, similarity, i, j);
 		}
-		sprintf(prompt, "Section Header[%u]", i+1);
-		differ += diff_header(prompt, sec1, sec2);
-
-		sprintf(prompt, "Section RawData[%u] %s <=> %s:", i+1, sec1.Name, sec2.Name);
-		differ += diff_rawdata(prompt,
-			exe1.MappedAddress + sec1.PointerToRawData, size_of_rawdata(sec1),
-			exe2.MappedAddress + sec2.PointerToRawData, size_of_rawdata(sec2));
-	}//.endfor
-
-	if (differ != 0)
-		printf("\"%s\" and \"%s\" differ\n",        exe1.ModuleName, exe2.ModuleName);
-	else
-		printf("\"%s\" and \"%s\" are identical\n", exe1.ModuleName, exe2.ModuleName);
+		for (size_t b = 0; b < SKETCH_BANDS; ++b) {
+			DWORD key = sketch_band(sk2, b);
+			size_t lo = 0, hi = nbands;		// keỷ񕪒T.
+			while (lo < hi) {
+				size_t mid = (lo + hi) / 2;
+				if (bands[mid].key < key) lo = mid + 1; else hi = mid;
+			}
+			for (; lo < nbands && bands[lo].key == key; ++lo) {
+				size_t j = bands[lo].id;
+				if (seen[j] == i + 1)
+					continue;
+				seen[j] = i + 1;
+				size_t similarity = rename_similarity(sk1[j], sk2);
+				if (similarity >= gRenameThreshold)
+					add_rename_pair(pairs, npairs, capacity, similarity, i, j);
+			}
+		}
+		free(sk2.bytes);
+	}
 
-	return differ;
+	// ގx̍gAǂ܂ΉtĂȂ΍̗p.
+	if (npairs > 1)
+		qsort(pairs, npairs, sizeof(RenamePair), compare_rename_pairs);
+	for (size_t k = 0; k < npairs; ++k) {
+		const RenamePair& pair = pairs[k];
+		if (names1[pair.i2] != NULL || used1.Find(cand1[pair.j1]))
+			continue;
+		names1[pair.i2] = cand1[pair.j1];
+		used1.Add(cand1[pair.j1]);
+		if (!gQuiet)
+			printf("\"%s\" is renamed to \"%s\" (similarity %lu%%)\n", cand1[pair.j1], entries[pair.i2], (ulong)pair.similarity);
+	}
+	free(pairs);
+	delete[] seen;
+	delete[] small1;
+	delete[] bands;
+	for (size_t j = 0; j < cand1.Count(); ++j)
+		free(sk1[j].bytes);
+	delete[] sk1;
 }
-
+//@}
 
 //------------------------------------------------------------------------
-/** [hC[Wrs.
- * @retval 0 v
- * @retval 1 sv
+/** DIR2  WILD ɍvt@CoADIR1̓t@CƔr.
+ * -s ȂADIR1̓t@CɃXibvVbg.
+ * DIR1/DIR2 ǂ߂ȂΈُI.
+ * @return IR[h. 0:v 1:sv 2:ǂݍݎs ̘_a.
  */
-int Compare(const ExeFileImage& f1, const ExeFileImage& f2)
+int CompareFolder(const char* dir1, const char* dir2, const char* wild)
 {
-	if (gDumpFileImage) {
-		f1.print();
-		f2.print();
+	int ret = EXIT_SUCCESS;
+
+	// DIR1/DIR2 ZIPɂł悢. ꗗ̖O͏ɂ̒ŵŁAɂ͔rI܂ŊJĂ.
+	gDirDiff = true;
+	bool archive1 = IsArchive(dir1);
+	bool archive2 = IsArchive(dir2);
+	if (!archive1) ValidateFolder(dir1);
+	if (!archive2) ValidateFolder(dir2);
+	if (archive1 && gWriteSnapshot)
+		error_abort("cannot write snapshot into zip archive", dir1);
+	EntryProc proc = gWriteSnapshot ? WriteSnapshotEntry : CompareEntry;
+
+	// ǂ݂̂߁AΏۂ̃t@CɑSďW߂. т͗񋓏̂܂.
+	NameSet entries;
+	const ZipArchive* zip2 = NULL;
+	if (archive2) {
+		zip2 = OpenArchive(dir2);
+		if (zip2 == NULL) {
+			print_win32error(dir2);
+			error_abort();
+		}
+		WildPattern pattern(wild);
+		for (size_t i = 0; i < zip2->Count(); ++i) {
+			const ZipArchive::Member& m = (*zip2)[i];
+			if (m.IsFolder() || !pattern.Match(m.name))
+				continue;
+			entries.AddRef(m.name);
+		}//.endfor
+	}
+	else if (!ListFolder(dir2, wild, entries)) {
+		print_win32error(dir2);
+		error_abort();
 	}
-	return diff(f1, f2) != 0;
-}
 
-/** [hC[Wrs.
- * @retval 0 v
- * @retval 1 sv
- * @retval 2 t@Cǂݍݎs
- */
-int Compare(const char* fname1, const char* fname2)
-{
-	ExeFileImage f1(fname1); if (!f1.IsLoaded()) { print_win32error(fname1); return 2; }
-	ExeFileImage f2(fname2); if (!f2.IsLoaded()) { print_win32error(fname2); return 2; }
-	return Compare(f1, f2);
+	// DIR1̓t@ĆAꗗő啶𖳎ĒT.
+	// -s ȂDIR1͏oȂ̂ŒTȂ.
+	NameSet list1;
+	NameIndex index1;
+	bool indexed = !gWriteSnapshot;
+	const ZipArchive* zip1 = NULL;
+	if (indexed && archive1) {
+		zip1 = OpenArchive(dir1);
+		if (zip1 == NULL) {
+			print_win32error(dir1);
+			error_abort();
+		}
+		for (size_t i = 0; i < zip1->Count(); ++i) {
+			if (!(*zip1)[i].IsFolder())
+				list1.AddRef((*zip1)[i].name);
+		}//.endfor
+	}
+	else if (indexed && !ListFolder(dir1, "*", list1)) {
+		print_win32error(dir1);
+		error_abort();
+	}
+	for (size_t i = 0; i < list1.Count(); ++i)
+		index1.Add(list1[i]);
+	const char** names1 = new const char*[entries.Count() + 1];	// entriesɑΉDIR1̖O. NULL.
+	for (size_t i = 0; i < entries.Count(); ++i)
+		names1[i] = indexed ? index1.Find(entries[i]) : entries[i];
+
+	// -r# ȂÂ̖e̗ގxőΉt.
+	if (indexed && gRenameThreshold != 0)
+		MatchRenamed(dir1, archive1, list1, dir2, archive2, entries, names1, wild);
+
+	// Ɏ gPrefetchCount gǂ݂ȂA1g.
+	Prefetcher prefetcher;
+	for (size_t i = 0; i < entries.Count() && i < gPrefetchCount; ++i)
+		PrefetchEntry(prefetcher, dir1, archive1, names1[i], dir2, archive2, entries[i]);
+	for (size_t i = 0; i < entries.Count(); ++i) {
+		if (gPrefetchCount != 0 && i + gPrefetchCount < entries.Count())
+			PrefetchEntry(prefetcher, dir1, archive1, names1[i + gPrefetchCount], dir2, archive2, entries[i + gPrefetchCount]);
+		if (names1[i] == NULL) {
+			// JƂƓG[At@C₢킹ɕ\.
+			char path1[_MAX_PATH];
+			make_entry_path(path1, dir1, archive1, entries[i]);
+			::SetLastError(ERROR_FILE_NOT_FOUND);
+			print_win32error(path1);
+			ret |= 2;
+			continue;
+		}
+		ret |= proc(dir1, archive1, names1[i], dir2, archive2, entries[i]);
+	}//.endfor
+	delete[] names1;
+	CloseArchive(zip1);
+	CloseArchive(zip2);
+	return ret;
 }
 
 //------------------------------------------------------------------------
-/** C֐ */
-int main(int argc, char* argv[])
-{
-	setlocale(LC_ALL, "");
+///@name R}hC̏
+//@{
+/** --serve=SOCKET: 풓[hő҂󂯂\Pbg */
+const char* gServeSocket = NULL;
 
-	//--- R}hC̃IvV͂.
+/** --connect=SOCKET: r˗풓vZX̃\Pbg */
+const char* gServerSocket = NULL;
+
+/** R}hC̃IvV͂Aargc/argv ŏ̃Iyh̒Oɐi߂. */
+void ParseOptions(int& argc, char**& argv)
+{
 	while (argc > 1 && argv[1][0] == '-') {
 		char* sw = &argv[1][1];
 		int i;
 		if (strcmp(sw, "help") == 0)
 			goto show_help;
+		else if (strcmp(sw, "-brief") == 0) {
+			gBrief = true;
+			gQuiet = true;
+			gDiffLength = 0;	// ubNPʂ̔rŏ̍قőł؂.
+		}
+		else if (strncmp(sw, "-serve=", 7) == 0 && sw[7])
+			gServeSocket = sw + 7;
+		else if (strncmp(sw, "-connect=", 9) == 0 && sw[9])
+			gServerSocket = sw + 9;
 		else if (sscanf(sw, "n%i", &i) == 1)
 			gDiffLength = i;
+		else if (sscanf(sw, "b%i", &i) == 1 && i > 0)
+			gSnapshotBlockSize = i;
+		else if (sscanf(sw, "m%i", &i) == 1 && i >= 0)
+			gCacheBudget = i;
+		else if (sscanf(sw, "p%i", &i) == 1 && i >= 0)
+			gPrefetchCount = i;
+		else if (sscanf(sw, "j%i", &i) == 1 && i >= 0)
+			gThreads = i;
+		else if (sscanf(sw, "r%i", &i) == 1 && i >= 0 && i <= 100)
+			gRenameThreshold = i;
 		else {
 			do {
 				switch (*sw) {
@@ -800,6 +4110,18 @@ show_help:			error_abort(gUsage2);
 				case 'q':
 					gQuiet = true;
 					break;
+				case 's':
+					gWriteSnapshot = true;
+					break;
+				case 'a':
+					gCompareAll = true;
+					break;
+				case 'e':
+					gProfile = true;
+					break;
+				case 'r':
+					gRenameThreshold = 50;
+					break;
 				default:
 					errorf_abort("%s: unknown option '%c'.\n", argv[1], *sw);
 					break;
@@ -810,13 +4132,24 @@ show_help:			error_abort(gUsage2);
 		++argv;
 		--argc;
 	}
+}
+
+/** Iyhɏ]Ĕr܂̓XibvVbg̏os.
+ * @return IR[h. 0:v 1:sv 2:ǂݍݎs ̘_a.
+ */
+int Execute(int argc, char* argv[])
+{
 	if (argc < 3) {
 		error_abort("please specify FILE or DIR\n");
 	}
 
 	int ret = EXIT_SUCCESS;
 
-	if (argc == 3 && IsExistFile(argv[1])) {
+	if (gWriteSnapshot && argc == 3 && IsSingleFile(argv[2])) {
+		//--- R}hC FILE1 FILE2 oAFILE2 ̃XibvVbg FILE1 ɏ.
+		ret = WriteSnapshot(argv[1], argv[2]);
+	}
+	else if (!gWriteSnapshot && argc == 3 && IsSingleFile(argv[1])) {
 		//--- R}hCɂ FILE1 FILE2 oAt@Cr.
 		ret = Compare(argv[1], argv[2]);
 	}
@@ -831,23 +4164,464 @@ show_help:			error_abort(gUsage2);
 		if (argc <= 3 && has_wildcard(dir2))
 			separate_pathname(dir2, dir2, wild);
 
-		//--- DIR2  WILD ɍvt@CoADIR1̓t@CƔr.
-		gDirDiff = true;
-		ValidateFolder(dir1);
-		ValidateFolder(dir2);
-		FindFile find;
-		for (find.Open(dir2, wild); find; find.Next()) {
-			if (find.IsFolder())
-				continue;
-			char path1[_MAX_PATH];
-			char path2[_MAX_PATH];
-			_makepath(path1, NULL, dir1, find.name, NULL); // file1݂͑Ȃ\.
-			_makepath(path2, NULL, dir2, find.name, NULL);
-			ret |= Compare(path1, path2);
+		ret = CompareFolder(dir1, dir2, wild);
+	}
+	return ret;
+}
+//@}
+
+//------------------------------------------------------------------------
+///@name 풓[h
+/// CÎ悤ɒZrʂɌJԂꍇɁANƊt@C̓ǂݍ݂1ōς܂.
+/// --serve=SOCKET ŏ풓AUnixhC\PbgŔrv󂯕t.
+/// NɎw肵t@C͓ǂݍŌAy[WLbVɍڂăC[WLbVɎc.
+/// vƂ fork qvZX̂ŁAt@C̃C[W𕡐ɋLłA
+/// ṽIvVG[I͏풓vZXƑ̗vɉeȂ.
+/// ˗(--connect=SOCKET ܂͊ϐ EXEDIFF_SERVER)́AƍƃtH_ɉ
+/// Wo͂ƕWG[n̂ŁArʂ͈˗̏o͂ɒڏ.
+//@{
+#ifndef _WIN32
+/** rv̐擪. čƃtH_ƈAꂼNULI[ Length oCg.
+ * ˗̕Wo͂ƕWG[ SCM_RIGHTS œY. ͏IR[h DWORD.
+ */
+struct ServeRequest {
+	char Magic[4];		///< SERVE_MAGIC
+	DWORD Length;
+};
+
+const char SERVE_MAGIC[4] = { 'E', 'X', 'D', 'Q' };
+
+/** rv̖{̂̏. */
+const DWORD SERVE_MAX_REQUEST = 1024 * 1024;
+
+/** v̎qvZXŁAIR[hԂ\Pbg. */
+int gReplySocket = -1;
+
+/** o͂foĂA˗ɏIR[hԂ. */
+void reply_status(int status)
+{
+	fflush(stdout);
+	fflush(stderr);
+	if (gReplySocket < 0)
+		return;
+	DWORD code = status;
+	if (write(gReplySocket, &code, sizeof(code)) != sizeof(code))
+		perror("exediff: reply");
+	close(gReplySocket);
+	gReplySocket = -1;
+}
+
+/** error_abort ɂ exit ł˗ɏIR[hԂ. */
+void reply_on_exit()
+{
+	reply_status(EXIT_FAILURE);
+}
+
+/** rv̐擪ƁAYꂽWo͂ƕWG[󂯎. */
+bool recv_request(int conn, ServeRequest& req, int fds[2])
+{
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(sizeof(int) * 2)];
+	} control;
+	struct iovec iov = { &req, sizeof(req) };
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+	if (recvmsg(conn, &msg, MSG_WAITALL) != sizeof(req))
+		return false;
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS
+		|| cmsg->cmsg_len != CMSG_LEN(sizeof(int) * 2))
+		return false;
+	memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * 2);
+	return memcmp(req.Magic, SERVE_MAGIC, sizeof(req.Magic)) == 0 && req.Length <= SERVE_MAX_REQUEST;
+}
+
+/** vƂɉ͂IvV. IvV𑝂₵Aɂ邱.
+ * -m# ̓C[WLbV̗\ZȂ̂ŁA풓vZX̒l̂܂܂ƂAɂ͓Ȃ.
+ */
+#define REQUEST_OPTIONS(X) \
+	X(bool, gIgnoreTimeStamp) X(bool, gIgnoreCheckSum) X(bool, gDumpFileImage) X(bool, gQuiet) \
+	X(size_t, gDiffLength) X(bool, gDirDiff) X(bool, gWriteSnapshot) X(size_t, gSnapshotBlockSize) \
+	X(bool, gCompareAll) X(size_t, gPrefetchCount) X(bool, gBrief) X(size_t, gThreads) \
+	X(size_t, gRenameThreshold) X(bool, gProfile) X(const char*, gServeSocket) X(const char*, gServerSocket)
+
+/** REQUEST_OPTIONS ̒l̑g. */
+struct RequestOptions {
+	#define DECLARE_OPTION(type, var)	type var;
+	REQUEST_OPTIONS(DECLARE_OPTION)
+	#undef DECLARE_OPTION
+};
+
+/** ݂̃IvV̒l𓾂. */
+RequestOptions current_request_options()
+{
+	RequestOptions o;
+	#define SAVE_OPTION(type, var)	o.var = var;
+	REQUEST_OPTIONS(SAVE_OPTION)
+	#undef SAVE_OPTION
+	return o;
+}
+
+/** IvV̊l. q̒lAmain  ParseOptions OɎʂĂ. */
+const RequestOptions gDefaultOptions = current_request_options();
+
+/** vƂ̃IvVlɖ߂. 풓vZXN -q ȂǂvɎzȂ. */
+void reset_request_options()
+{
+	#define RESTORE_OPTION(type, var)	var = gDefaultOptions.var;
+	REQUEST_OPTIONS(RESTORE_OPTION)
+	#undef RESTORE_OPTION
+}
+
+/** 1̔rv. vƂ fork qvZXŌĂ.
+ * @return IR[h.
+ */
+int ServeRequestProc(int conn)
+{
+	ServeRequest req;
+	int fds[2];
+	if (!recv_request(conn, req, fds)) {
+		fprintf(stderr, "exediff: bad request\n");
+		return 2;
+	}
+	char* body = (char*)malloc(req.Length + 1);
+	if (body == NULL || recv(conn, body, req.Length, MSG_WAITALL) != (ssize_t)req.Length) {
+		fprintf(stderr, "exediff: bad request\n");
+		return 2;
+	}
+	body[req.Length] = '\0';
+
+	// Ȍ̏o͈͂˗̕Wo͂ƕWG[ɏ. G[IĂIR[hԂ.
+	dup2(fds[0], 1);
+	dup2(fds[1], 2);
+	close(fds[0]);
+	close(fds[1]);
+	gReplySocket = conn;
+	atexit(reply_on_exit);
+
+	// {̂́AƃtH_ argv[1] ȍ~̕.
+	const char* end = body + req.Length;
+	const char* cwd = body;
+	int argc = 1;
+	for (const char* p = cwd + strlen(cwd) + 1; p < end; p += strlen(p) + 1)
+		++argc;
+	char** argv = new char*[argc + 1];
+	argc = 0;
+	argv[argc++] = const_cast<char*>("exediff");
+	for (char* p = body + strlen(cwd) + 1; p < end; p += strlen(p) + 1)
+		argv[argc++] = p;
+	argv[argc] = NULL;
+	if (chdir(cwd) != 0) {
+		print_win32error(cwd);
+		return 2;
+	}
+	reset_request_options();
+	ParseOptions(argc, argv);
+	if (gServeSocket != NULL || gServerSocket != NULL)
+		error_abort("cannot request --serve or --connect\n");
+	if (gWriteSnapshot)		// 풓vZX̌ł́A˗w肵t@Cɏ܂Ȃ.
+		error_abort("cannot request -s\n");
+	return Execute(argc, argv);
+}
+
+/** ڑ̑肪풓vZXƓ[U[? */
+bool peer_is_owner(int conn)
+{
+#ifdef SO_PEERCRED
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+	if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+		return false;
+	const uid_t uid = cred.uid;
+#else
+	uid_t uid;
+	gid_t gid;
+	if (getpeereid(conn, &uid, &gid) != 0)
+		return false;
+#endif
+	return uid == geteuid();
+}
+
+/** 󂯕tڑ̔rv1AIR[hԂ. vƂ fork qvZXŌĂ. */
+void ServeConnection(int conn)
+{
+	if (!peer_is_owner(conn)) {
+		fprintf(stderr, "exediff: rejected a request from another user\n");
+		close(conn);
+		return;
+	}
+	reply_status(ServeRequestProc(conn));
+}
+
+/** t@Cǂݍ݁AZNVf[^y[WLbVɍڂăLbVɎc.
+ * @return ǂݍ߂C[W̐.
+ */
+size_t preload_image(const char* path)
+{
+	ImageCache& cache = image_cache();
+	ExeFileImage* exe = cache.Acquire(path);
+	if (exe == NULL) {
+		print_win32error(path);
+		return 0;
+	}
+	volatile uchar sink = 0;
+	for (size_t i = 0; i < exe->NumberOfSections; ++i) {
+		const Span& r = exe->RawData(i);
+		for (size_t k = 0; r.data != NULL && k < r.size; k += 4096)
+			sink ^= r.data[k];
+	}
+	cache.Release(exe);
+	return 1;
+}
+
+/** t@CA܂̓tH_⏑ɂɂSt@Cǂݍ.
+ * @return ǂݍ߂C[W̐.
+ */
+size_t PreloadBaseline(const char* spec)
+{
+	const bool archive = IsArchive(spec);
+	if (!archive && !IsExistFolder(spec))
+		return preload_image(spec);
+	NameSet names;
+	if (archive) {
+		const ZipArchive* zip = OpenArchive(spec);
+		if (zip == NULL) {
+			print_win32error(spec);
+			return 0;
+		}
+		for (size_t i = 0; i < zip->Count(); ++i) {
+			if (!(*zip)[i].IsFolder())
+				names.Add((*zip)[i].name);
 		}//.endfor
+		CloseArchive(zip);
+	}
+	else if (!ListFolder(spec, "*", names)) {
+		print_win32error(spec);
+		return 0;
+	}
+	size_t n = 0;
+	for (size_t i = 0; i < names.Count(); ++i) {
+		char path[_MAX_PATH];
+		make_entry_path(path, spec, archive, names[i]);
+		n += preload_image(path);
+	}//.endfor
+	return n;
+}
+
+/** 풓vZXIɏ\Pbg. */
+const char* gListenPath = NULL;
+
+/** SIGINT/SIGTERM ő҂󂯃\PbgďI. */
+void stop_serving(int sig)
+{
+	if (gListenPath != NULL)
+		unlink(gListenPath);
+	_exit(128 + sig);
+}
+
+/** 풓[h. t@CǂݍłAsocket_path Ŕrv҂󂯂.
+ * @param argc, argv	Iyh̕. t@CAtH_܂͏.
+ */
+int Serve(const char* socket_path, int argc, char* argv[])
+{
+	gServing = true;
+	size_t n = 0;
+	for (int i = 1; i < argc; ++i)
+		n += PreloadBaseline(argv[i]);
+
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(socket_path) >= sizeof(addr.sun_path))
+		error_abort("too long socket name", socket_path);
+	strcpy(addr.sun_path, socket_path);
+
+	// Ȍ풓vZXc\Pbg͏. \PbgȊO͏Ȃ.
+	struct stat st;
+	if (lstat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode))
+		unlink(socket_path);
+	// \Pbg͏L҂ڑł悤 0600 ō. ʂ̃[U[̐ڑ ServeConnection łf.
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	const mode_t mask = umask(0177);
+	const bool bound = listener >= 0 && bind(listener, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+	umask(mask);
+	if (!bound || listen(listener, SOMAXCONN) != 0) {
+		print_win32error(socket_path);
+		return 2;
+	}
+	gListenPath = socket_path;
+	signal(SIGINT, stop_serving);
+	signal(SIGTERM, stop_serving);
+	signal(SIGCHLD, SIG_IGN);	// qvZX͑҂ɉ.
+	if (!gQuiet) {
+		printf("serving on \"%s\" with %u cached images\n", socket_path, (unsigned)n);
+		fflush(stdout);
+	}
+
+	for (;;) {
+		int conn = accept(listener, NULL, NULL);
+		if (conn < 0) {
+			if (errno != EINTR && errno != ECONNABORTED)
+				print_win32error(socket_path);
+			continue;
+		}
+		fflush(NULL);	// qvZXo̓obt@dēfoȂ悤ɂ.
+		pid_t pid = fork();
+		if (pid == 0) {
+			close(listener);
+			signal(SIGINT, SIG_DFL);
+			signal(SIGTERM, SIG_DFL);
+			signal(SIGCHLD, SIG_DFL);
+			ServeConnection(conn);
+			_exit(0);
+		}
+		if (pid < 0)
+			print_win32error("fork");
+		close(conn);
+	}
+}
+
+/** ڑς݂sockŏ풓vZXɔr˗ȀIR[hԂ. name̓G[\Ɏg. */
+int SendRequest(int sock, const char* name, int argc, char* argv[])
+{
+	//--- ƃtH_ƁA--connect ȊÖׂ.
+	char cwd[_MAX_PATH];
+	if (getcwd(cwd, sizeof(cwd)) == NULL) {
+		print_win32error(".");
+		return 2;
+	}
+	size_t len = strlen(cwd) + 1;
+	for (int i = 1; i < argc; ++i) {
+		if (strncmp(argv[i], "--connect=", 10) != 0)
+			len += strlen(argv[i]) + 1;
+	}
+	if (len > SERVE_MAX_REQUEST)
+		error_abort("too long arguments\n");
+	char* buf = (char*)malloc(sizeof(ServeRequest) + len);
+	ServeRequest* req = (ServeRequest*)buf;
+	memcpy(req->Magic, SERVE_MAGIC, sizeof(req->Magic));
+	req->Length = (DWORD)len;
+	char* p = buf + sizeof(ServeRequest);
+	strcpy(p, cwd);
+	p += strlen(p) + 1;
+	for (int i = 1; i < argc; ++i) {
+		if (strncmp(argv[i], "--connect=", 10) == 0)
+			continue;
+		strcpy(p, argv[i]);
+		p += strlen(p) + 1;
+	}//.endfor
+
+	//--- 擪ɕWo͂ƕWG[Yđ.
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(sizeof(int) * 2)];
+	} control;
+	memset(&control, 0, sizeof(control));
+	struct iovec iov = { buf, sizeof(ServeRequest) + req->Length };
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int) * 2);
+	const int fds[2] = { 1, 2 };
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+	fflush(stdout);
+	fflush(stderr);
+	ssize_t sent = sendmsg(sock, &msg, 0);
+	for (size_t total = sent > 0 ? sent : 0; sent > 0 && total < iov.iov_len; total += sent)
+		sent = send(sock, buf + total, iov.iov_len - total, 0);
+	free(buf);
+	if (sent <= 0) {
+		print_win32error(name);
+		return 2;
+	}
+
+	//--- IR[h҂.
+	DWORD code;
+	ssize_t n = recv(sock, &code, sizeof(code), MSG_WAITALL);
+	if (n != sizeof(code)) {
+		fprintf(stderr, "%s: no reply from exediff server\n", name);
+		return 2;
+	}
+	return (int)code;
+}
+
+/** 풓vZXɔr˗ȀIR[hԂ.
+ * ƍƃtH_ɓYĕWo͂ƕWG[n̂ŁAʂ͂ɒڏ.
+ * @param required	trueȂڑłȂꍇɃG[Ƃ. falseȂ-1ԂAŔr.
+ * @return 풓vZXł̏IR[h. ڑłȂ2܂-1.
+ */
+int Connect(const char* socket_path, int argc, char* argv[], bool required)
+{
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+	int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0 || connect(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+		if (!required) {
+			if (sock >= 0) close(sock);
+			return -1;
+		}
+		print_win32error(socket_path);
+		return 2;
 	}
+	int ret = SendRequest(sock, socket_path, argc, argv);
+	close(sock);
 	return ret;
 }
+#else
+int Serve(const char* socket_path, int, char*[])
+{
+	error_abort("--serve is not supported on this platform", socket_path);
+	return 2;
+}
+
+int Connect(const char* socket_path, int, char*[], bool required)
+{
+	if (required)
+		error_abort("--connect is not supported on this platform", socket_path);
+	return -1;
+}
+#endif
+//@}
+
+#ifndef EXEDIFF_NO_MAIN		// t@WOpn[lXɖ{t@Cgݍޏꍇ͒`.
+/** C֐ */
+int main(int argc, char* argv[])
+{
+	setlocale(LC_ALL, "");
+
+	//--- R}hC̃IvV͂.
+	const int argc0 = argc;
+	char** const argv0 = argv;
+	ParseOptions(argc, argv);
+
+	//--- --serve Ȃ풓. --connect ϐ EXEDIFF_SERVER ΁A풓vZXɈ˗.
+	// ϐɂ˗́A풓vZXɐڑłȂΎŔr.
+	if (gServeSocket != NULL && gServerSocket != NULL)
+		error_abort("cannot use --serve with --connect\n");
+	if (gServeSocket != NULL)
+		return Serve(gServeSocket, argc, argv);
+	const char* server = gServerSocket ? gServerSocket : getenv("EXEDIFF_SERVER");
+	if (server != NULL && *server) {
+		int ret = Connect(server, argc0, argv0, gServerSocket != NULL);
+		if (ret >= 0)
+			return ret;
+	}
+	return Execute(argc, argv);
+}
+#endif // EXEDIFF_NO_MAIN
 
 //------------------------------------------------------------------------
 /**@mainpage find differences between two windows binary files(exe/dll)
@@ -869,18 +4643,42 @@ show_help:			error_abort(gUsage2);
 @section func 
 	- [hC[W̃wb_\FA\Pʂł̔rs܂B
 	- [hC[W̃ZNVf[^(RAWDATA)̔rł́AقʂɒBrł؂܂B
-	- fBNgԂŕt@C̔rł܂B
+	- fBNgԂŕt@C̔rł܂BDIR1̓t@ĆA啶𖳎ĒT܂B
+	-r# wɂA̖t@Ce(ZNVf[^ƃGNX|[g/C|[g)̗ގxőΉtAꂽt@Cr܂B
+	fBNgrł́Aɔrt@C(-p#, 4g)ǂ݂Aǂݍ񂾃C[W\Z(-m#, 256MB)ŃLbV܂B
+	- ZIPɂWJɁAɓ̃t@Crł܂B("ARCHIVE.zip!MEMBER" ܂DIRƂZIPɂw)
+	- [Xł̃XibvVbg(wb_AZNV\AubNnbVAGNX|[g/C|[g) -s ŕۑA
+	̃t@C FILE1/DIR1 ƂĔrł܂Bق̓ubN(-b#, 4096oCg)PʂŎ܂B
+	- -a wɂAwb_̗]AZNV̋lߕAؖAI[o[C(ŏIZNVȍ~̒ǉf[^)܂߂āA
+	t@CŜRȂrł܂B-d ƕpƁAeoCg蓖Ă̈\o͂܂B
 	- IvVwɂA[hC[Wɖߍ܂ꂽ^CX^vƃ`FbNTOĔrł܂B
+	- --brief wɂAvsv𔻒肵܂B傫Awb_AZNVf[^̏ɒׂčŏ̍قőł؂A
+	傫ȃZNV͕Xbh(-j#)ŕSĔr܂B
 	- rt@C̃eLXg`_v(dumpbin /all )o͂ł܂B
+	- -e wɂAZNVf[^̃Ggs[0̕тAŜ4KB̑Ƃɕ͂܂B
+	_vɉقAقȂZNVł͗҂ׁAωkEÍf[^R[h\܂B
+	- ǂݍݎɃZNV\AZNVf[^Af[^fBNg͈̔͂Aꂽt@Cł͈͊Oǂ݂܂B
+	t@CzZNVf[^́A܂镔܂łr܂B
+	- POSIXł --serve=SOCKET ŏ풓At@Cǂݍ񂾂܂ܔrv󂯕t܂B
+	--connect=SOCKET ܂͊ϐ EXEDIFF_SERVER w肵 exediff ́A풓vZXɔr˗ēo͂ƏIR[hԂ܂B
 
 @section env 
 	WindowsNT3.1/Windows95ȍ~B
 	Windows98SE/Windows2000/WindowsXP ɂēmFς݁B
+	LinuxPOSIXłACMakeŃrhē삵܂(Win32 API ̑ւ posix.h/posix.cpp)B
 
 @section install CXg[@
 	zzt@C windiff.exe APATHʂtH_ɃRs[ĂB
 	ACCXg[ɂ́ÃRs[t@C폜ĂB
 
+	Linuxł́ACMakeŃrhăCXg[܂B
+@verbatim
+cmake -S . -B build && cmake --build build && ctest --test-dir build
+cmake --install build
+@endverbatim
+	-DEXEDIFF_LTO=ONA-DEXEDIFF_PGO=GENERATE|USEA-DEXEDIFF_SANITIZE=address,undefinedA-DEXEDIFF_FUZZ=ON(clang)
+	ōœKł⌟ł܂Bbuild/exediff_bench ŔrGW̏vԂ𑪂܂B
+
 @section usage g
 	@verbinclude usage.tmp
 
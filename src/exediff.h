@@ -0,0 +1,69 @@
+/**@file exediff.h -- exediff library interface.
+ * exediff.cpp  EXEDIFF_NO_MAIN tŃCuƂđgݍޏꍇ̌J錾.
+ * r̐U镑̓R}hCIvVƓO[oϐŎw肷.
+ * @author Hiroshi Kuno <hkuno-exediff-tool@microhouse.co.jp>
+ */
+#ifndef EXEDIFF_H
+#define EXEDIFF_H
+#include <stddef.h>
+
+//------------------------------------------------------------------------
+///@name IvV. ΉR}hCIvV𕹋L.
+//@{
+extern bool gIgnoreTimeStamp;		///< -t
+extern bool gIgnoreCheckSum;		///< -c
+extern bool gDumpFileImage;			///< -d
+extern bool gQuiet;					///< -q
+extern size_t gDiffLength;			///< -n#
+extern bool gDirDiff;				///< fBNgr.
+extern bool gWriteSnapshot;			///< -s
+extern size_t gSnapshotBlockSize;	///< -b#
+extern bool gCompareAll;			///< -a
+extern size_t gCacheBudget;			///< -m#
+extern size_t gPrefetchCount;		///< -p#
+extern bool gBrief;					///< --brief. gQuiet 𗧂āAgDiffLength 0ɂĎg.
+extern size_t gThreads;				///< -j#
+extern size_t gRenameThreshold;		///< -r#
+extern bool gProfile;				///< -e
+//@}
+
+//------------------------------------------------------------------------
+///@name rƃXibvVbg
+//@{
+/** [hC[Wrs. fnameɂ "ARCHIVE.zip!MEMBER" `ƃXibvVbgwł.
+ * @retval 0 v
+ * @retval 1 sv
+ * @retval 2 t@Cǂݍݎs
+ */
+int Compare(const char* fname1, const char* fname2);
+
+/** fname2̃XibvVbgfname1ɏo.
+ * @retval 0 
+ * @retval 2 ǂݍ݂܂͏݂̎s
+ */
+int WriteSnapshot(const char* fname1, const char* fname2);
+
+/** DIR2  WILD ɍvt@CADIR1̓t@CƔr. Ȏ啶͋ʂȂ.
+ * -s ȂXibvVbgoA-r# Ȃ瓯̖̂ގxőΉt.
+ * DIR1/DIR2 ZIPɂł悢. DIR1/DIR2 ǂ߂ȂΈُI.
+ * @return 0:v 1:sv 2:ǂݍݎs ̘_a.
+ */
+int CompareFolder(const char* dir1, const char* dir2, const char* wild);
+
+#ifndef _WIN32
+/** 풓[hŎ󂯕tڑconn̔rv1A˗ɏIR[hԂ.
+ * ˗̕Wo͂ƕWG[󂯎ĕtւAG[IłIR[hԂ̂ŁA
+ * vƂ fork qvZXŌĂԂ. ʂ̃[U[̗v -s ̗v͒f.
+ */
+void ServeConnection(int conn);
+
+/** ڑς݂sockŏ풓vZXɔr˗ȀIR[hԂ.
+ * argv[1] ȍ~̈ƍƃtH_ɓYĕWo͂ƕWG[n̂ŁAʂ͂ɒڏ.
+ * @param name	G[\Ɏgڑ̖O.
+ * @retval 2	˗łȂ.
+ */
+int SendRequest(int sock, const char* name, int argc, char* argv[]);
+#endif
+//@}
+
+#endif // EXEDIFF_H
@@ -0,0 +1,186 @@
+/**@file posix.cpp -- Win32 API subset for POSIX.
+ * posix.h Ő錾 imagehlp  CRT ̊֐Ammap  opendir Ŏ.
+ * @author Hiroshi Kuno <hkuno-exediff-tool@microhouse.co.jp>
+ */
+#include "posix.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+//------------------------------------------------------------------------
+// imagehlp
+PIMAGE_NT_HEADERS ImageNtHeader(void* base)
+{
+	const IMAGE_DOS_HEADER* dos = (const IMAGE_DOS_HEADER*)base;
+	if (dos->e_magic != IMAGE_DOS_SIGNATURE)
+		return NULL;
+	PIMAGE_NT_HEADERS nt = (PIMAGE_NT_HEADERS)((BYTE*)base + dos->e_lfanew);
+	return nt->Signature == IMAGE_NT_SIGNATURE ? nt : NULL;
+}
+
+BOOL MapAndLoad(PSTR imageName, const char*, LOADED_IMAGE* loaded, BOOL, BOOL)
+{
+	memset(loaded, 0, sizeof(*loaded));
+	int fd = open(imageName, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return FALSE;
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		int error = errno;
+		close(fd);
+		errno = error;
+		return FALSE;
+	}
+	// imagehlp ƓlɁAwb_ƃZNV\t@CɎ܂ȂΓǂ܂Ȃ.
+	const size_t size = (size_t)st.st_size;
+	if (!S_ISREG(st.st_mode) || (unsigned long long)st.st_size >= 0x100000000ULL || size < sizeof(IMAGE_DOS_HEADER)) {
+		close(fd);
+		errno = S_ISDIR(st.st_mode) ? EISDIR : ENOEXEC;
+		return FALSE;
+	}
+	void* base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	int error = errno;
+	close(fd);
+	if (base == MAP_FAILED) {
+		errno = error;
+		return FALSE;
+	}
+	const IMAGE_DOS_HEADER* dos = (const IMAGE_DOS_HEADER*)base;
+	PIMAGE_NT_HEADERS nt = NULL;
+	if (dos->e_magic == IMAGE_DOS_SIGNATURE && dos->e_lfanew >= 0
+		&& (unsigned long)dos->e_lfanew + sizeof(IMAGE_NT_HEADERS) <= size)
+		nt = ImageNtHeader(base);
+	if (nt == NULL || (BYTE*)(IMAGE_FIRST_SECTION(nt) + nt->FileHeader.NumberOfSections) > (BYTE*)base + size) {
+		munmap(base, size);
+		errno = ENOEXEC;
+		return FALSE;
+	}
+	loaded->ModuleName       = strdup(imageName);
+	loaded->hFile            = INVALID_HANDLE_VALUE;
+	loaded->MappedAddress    = (PUCHAR)base;
+	loaded->FileHeader       = nt;
+	loaded->NumberOfSections = nt->FileHeader.NumberOfSections;
+	loaded->Sections         = IMAGE_FIRST_SECTION(nt);
+	loaded->Characteristics  = nt->FileHeader.Characteristics;
+	loaded->fReadOnly        = TRUE;
+	loaded->SizeOfImage      = (ULONG)size;
+	return TRUE;
+}
+
+BOOL UnMapAndLoad(LOADED_IMAGE* loaded)
+{
+	munmap(loaded->MappedAddress, loaded->SizeOfImage);
+	free(loaded->ModuleName);
+	memset(loaded, 0, sizeof(*loaded));
+	return TRUE;
+}
+
+//------------------------------------------------------------------------
+// t@C
+void _splitpath(const char* path, char* drive, char* dir, char* fname, char* ext)
+{
+	const char* name = path;
+	for (const char* p = path; *p; ++p) {
+		if (*p == '/' || *p == '\\')
+			name = p + 1;
+	}
+	const char* dot = strrchr(name, '.');
+	if (dot == NULL)
+		dot = name + strlen(name);
+	if (drive != NULL)
+		drive[0] = '\0';
+	if (dir != NULL) {
+		memcpy(dir, path, name - path);
+		dir[name - path] = '\0';
+	}
+	if (fname != NULL) {
+		memcpy(fname, name, dot - name);
+		fname[dot - name] = '\0';
+	}
+	if (ext != NULL)
+		strcpy(ext, dot);
+}
+
+void _makepath(char* path, const char* drive, const char* dir, const char* fname, const char* ext)
+{
+	path[0] = '\0';
+	if (drive != NULL)
+		strcat(path, drive);
+	if (dir != NULL && *dir) {
+		strcat(path, dir);
+		char last = path[strlen(path) - 1];
+		if (last != '/' && last != '\\')
+			strcat(path, "/");
+	}
+	if (fname != NULL)
+		strcat(path, fname);
+	if (ext != NULL && *ext) {
+		if (*ext != '.')
+			strcat(path, ".");
+		strcat(path, ext);
+	}
+}
+
+//------------------------------------------------------------------------
+// t@C
+namespace {
+/** _findfirst ̌nh̎. */
+struct FindContext {
+	DIR* dir;
+	char folder[_MAX_PATH];
+	char pattern[_MAX_FNAME + _MAX_EXT];	// _splitpath ŕOƊgqȂ.
+};
+}
+
+int _findnext(long handle, _finddata_t* data)
+{
+	FindContext* ctx = (FindContext*)handle;
+	while (struct dirent* e = readdir(ctx->dir)) {
+		if (fnmatch(ctx->pattern, e->d_name, FNM_CASEFOLD) != 0)
+			continue;
+		char path[_MAX_PATH + _MAX_FNAME + 1];
+		snprintf(path, sizeof(path), "%s/%s", ctx->folder, e->d_name);
+		struct stat st;
+		if (stat(path, &st) != 0)
+			continue;		// 񋓌ɏڂA؂ꂽV{bNN.
+		snprintf(data->name, sizeof(data->name), "%s", e->d_name);
+		data->attrib = S_ISDIR(st.st_mode) ? _A_SUBDIR : 0;
+		data->size = (long)st.st_size;
+		return 0;
+	}
+	return -1;
+}
+
+long _findfirst(const char* pathname, _finddata_t* data)
+{
+	FindContext* ctx = new FindContext;
+	char fname[_MAX_FNAME];
+	char ext[_MAX_EXT];
+	_splitpath(pathname, NULL, ctx->folder, fname, ext);
+	snprintf(ctx->pattern, sizeof(ctx->pattern), "%s%s", fname, ext);
+	if (ctx->folder[0] == '\0')
+		strcpy(ctx->folder, ".");
+	ctx->dir = opendir(ctx->folder);
+	if (ctx->dir == NULL) {
+		delete ctx;
+		return -1;
+	}
+	if (_findnext((long)ctx, data) != 0) {
+		_findclose((long)ctx);
+		return -1;
+	}
+	return (long)ctx;
+}
+
+int _findclose(long handle)
+{
+	FindContext* ctx = (FindContext*)handle;
+	closedir(ctx->dir);
+	delete ctx;
+	return 0;
+}
@@ -0,0 +1,338 @@
+/**@file posix.h -- Win32 API subset for POSIX.
+ * exediff.cpp g Win32/imagehlp/CRT ̌^APE\́A֐APOSIXœOŒ񋟂.
+ * PE\̂ winnt.h Ɠzu32bit(PE32)`.
+ * @author Hiroshi Kuno <hkuno-exediff-tool@microhouse.co.jp>
+ */
+#ifndef EXEDIFF_POSIX_H
+#define EXEDIFF_POSIX_H
+#ifdef _WIN32
+#error "posix.h is only for non-Windows platforms. include windows.h instead."
+#endif
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+
+//------------------------------------------------------------------------
+///@name {^ƒ萔
+//@{
+typedef uint8_t  BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef int32_t  LONG;
+typedef uint32_t ULONG;
+typedef unsigned char UCHAR;
+typedef UCHAR* PUCHAR;
+typedef char* PSTR;
+typedef int BOOL;
+typedef void* HANDLE;
+
+#define TRUE	1
+#define FALSE	0
+#define INVALID_HANDLE_VALUE	((HANDLE)(intptr_t)-1)
+
+// windows.h  min/max }N̑. C++Wwb_ min/max }N̂Ŋ֐ev[gɂ.
+template <class T> inline T min(T a, T b) { return (a < b) ? a : b; }
+template <class T> inline T max(T a, T b) { return (a > b) ? a : b; }
+
+#define _MAX_PATH	4096
+#define _MAX_DRIVE	3
+#define _MAX_DIR	4096
+#define _MAX_FNAME	256
+#define _MAX_EXT	256
+//@}
+
+//------------------------------------------------------------------------
+///@name G[R[h. GetLastError()  errno ̂܂ܕԂ.
+//@{
+#define ERROR_FILE_NOT_FOUND	ENOENT
+#define ERROR_NOT_ENOUGH_MEMORY	ENOMEM
+#define ERROR_BAD_FORMAT		ENOEXEC
+#define ERROR_INVALID_DATA		EILSEQ
+
+inline DWORD GetLastError()
+{
+	return errno;
+}
+
+inline void SetLastError(DWORD error)
+{
+	errno = (int)error;
+}
+//@}
+
+//------------------------------------------------------------------------
+///@name PE/COFF\ (winnt.h)
+//@{
+#pragma pack(push, 2)
+struct IMAGE_DOS_HEADER {
+	WORD e_magic, e_cblp, e_cp, e_crlc, e_cparhdr, e_minalloc, e_maxalloc, e_ss, e_sp,
+		e_csum, e_ip, e_cs, e_lfarlc, e_ovno, e_res[4], e_oemid, e_oeminfo, e_res2[10];
+	LONG e_lfanew;
+};
+#pragma pack(pop)
+
+struct IMAGE_FILE_HEADER {
+	WORD  Machine;
+	WORD  NumberOfSections;
+	DWORD TimeDateStamp;
+	DWORD PointerToSymbolTable;
+	DWORD NumberOfSymbols;
+	WORD  SizeOfOptionalHeader;
+	WORD  Characteristics;
+};
+
+struct IMAGE_DATA_DIRECTORY {
+	DWORD VirtualAddress;
+	DWORD Size;
+};
+
+#define IMAGE_NUMBEROF_DIRECTORY_ENTRIES	16
+
+struct IMAGE_OPTIONAL_HEADER {
+	WORD  Magic;
+	BYTE  MajorLinkerVersion;
+	BYTE  MinorLinkerVersion;
+	DWORD SizeOfCode;
+	DWORD SizeOfInitializedData;
+	DWORD SizeOfUninitializedData;
+	DWORD AddressOfEntryPoint;
+	DWORD BaseOfCode;
+	DWORD BaseOfData;
+	DWORD ImageBase;
+	DWORD SectionAlignment;
+	DWORD FileAlignment;
+	WORD  MajorOperatingSystemVersion;
+	WORD  MinorOperatingSystemVersion;
+	WORD  MajorImageVersion;
+	WORD  MinorImageVersion;
+	WORD  MajorSubsystemVersion;
+	WORD  MinorSubsystemVersion;
+	DWORD Win32VersionValue;
+	DWORD SizeOfImage;
+	DWORD SizeOfHeaders;
+	DWORD CheckSum;
+	WORD  Subsystem;
+	WORD  DllCharacteristics;
+	DWORD SizeOfStackReserve;
+	DWORD SizeOfStackCommit;
+	DWORD SizeOfHeapReserve;
+	DWORD SizeOfHeapCommit;
+	DWORD LoaderFlags;
+	DWORD NumberOfRvaAndSizes;
+	IMAGE_DATA_DIRECTORY DataDirectory[IMAGE_NUMBEROF_DIRECTORY_ENTRIES];
+};
+
+struct IMAGE_NT_HEADERS {
+	DWORD Signature;
+	IMAGE_FILE_HEADER FileHeader;
+	IMAGE_OPTIONAL_HEADER OptionalHeader;
+};
+typedef IMAGE_NT_HEADERS* PIMAGE_NT_HEADERS;
+
+#define IMAGE_SIZEOF_SHORT_NAME	8
+
+struct IMAGE_SECTION_HEADER {
+	BYTE  Name[IMAGE_SIZEOF_SHORT_NAME];
+	union {
+		DWORD PhysicalAddress;
+		DWORD VirtualSize;
+	} Misc;
+	DWORD VirtualAddress;
+	DWORD SizeOfRawData;
+	DWORD PointerToRawData;
+	DWORD PointerToRelocations;
+	DWORD PointerToLinenumbers;
+	WORD  NumberOfRelocations;
+	WORD  NumberOfLinenumbers;
+	DWORD Characteristics;
+};
+typedef IMAGE_SECTION_HEADER* PIMAGE_SECTION_HEADER;
+
+#define IMAGE_FIRST_SECTION(nt)	((PIMAGE_SECTION_HEADER)((BYTE*)(nt) \
+	+ offsetof(IMAGE_NT_HEADERS, OptionalHeader) + (nt)->FileHeader.SizeOfOptionalHeader))
+
+struct IMAGE_EXPORT_DIRECTORY {
+	DWORD Characteristics;
+	DWORD TimeDateStamp;
+	WORD  MajorVersion;
+	WORD  MinorVersion;
+	DWORD Name;
+	DWORD Base;
+	DWORD NumberOfFunctions;
+	DWORD NumberOfNames;
+	DWORD AddressOfFunctions;
+	DWORD AddressOfNames;
+	DWORD AddressOfNameOrdinals;
+};
+
+struct IMAGE_IMPORT_DESCRIPTOR {
+	DWORD OriginalFirstThunk;
+	DWORD TimeDateStamp;
+	DWORD ForwarderChain;
+	DWORD Name;
+	DWORD FirstThunk;
+};
+
+#define IMAGE_DOS_SIGNATURE				0x5A4D
+#define IMAGE_NT_SIGNATURE				0x00004550
+#define IMAGE_NT_OPTIONAL_HDR32_MAGIC	0x10B
+#define IMAGE_ORDINAL_FLAG32			0x80000000
+
+#define IMAGE_DIRECTORY_ENTRY_EXPORT	0
+#define IMAGE_DIRECTORY_ENTRY_IMPORT	1
+#define IMAGE_DIRECTORY_ENTRY_SECURITY	4
+
+#define IMAGE_FILE_MACHINE_I386		0x014C
+#define IMAGE_FILE_MACHINE_ALPHA	0x0184
+#define IMAGE_FILE_MACHINE_POWERPC	0x01F0
+#define IMAGE_FILE_MACHINE_IA64		0x0200
+#define IMAGE_FILE_MACHINE_AMD64	0x8664
+
+#define IMAGE_FILE_RELOCS_STRIPPED			0x0001
+#define IMAGE_FILE_EXECUTABLE_IMAGE			0x0002
+#define IMAGE_FILE_LINE_NUMS_STRIPPED		0x0004
+#define IMAGE_FILE_LOCAL_SYMS_STRIPPED		0x0008
+#define IMAGE_FILE_AGGRESIVE_WS_TRIM		0x0010
+#define IMAGE_FILE_LARGE_ADDRESS_AWARE		0x0020
+#define IMAGE_FILE_BYTES_REVERSED_LO		0x0080
+#define IMAGE_FILE_32BIT_MACHINE			0x0100
+#define IMAGE_FILE_DEBUG_STRIPPED			0x0200
+#define IMAGE_FILE_REMOVABLE_RUN_FROM_SWAP	0x0400
+#define IMAGE_FILE_NET_RUN_FROM_SWAP		0x0800
+#define IMAGE_FILE_SYSTEM					0x1000
+#define IMAGE_FILE_DLL						0x2000
+#define IMAGE_FILE_UP_SYSTEM_ONLY			0x4000
+#define IMAGE_FILE_BYTES_REVERSED_HI		0x8000
+
+#define IMAGE_SUBSYSTEM_UNKNOWN						0
+#define IMAGE_SUBSYSTEM_NATIVE						1
+#define IMAGE_SUBSYSTEM_WINDOWS_GUI					2
+#define IMAGE_SUBSYSTEM_WINDOWS_CUI					3
+#define IMAGE_SUBSYSTEM_OS2_CUI						5
+#define IMAGE_SUBSYSTEM_POSIX_CUI					7
+#define IMAGE_SUBSYSTEM_NATIVE_WINDOWS				8
+#define IMAGE_SUBSYSTEM_WINDOWS_CE_GUI				9
+#define IMAGE_SUBSYSTEM_EFI_APPLICATION				10
+#define IMAGE_SUBSYSTEM_EFI_BOOT_SERVICE_DRIVER		11
+#define IMAGE_SUBSYSTEM_EFI_RUNTIME_DRIVER			12
+#define IMAGE_SUBSYSTEM_EFI_ROM						13
+#define IMAGE_SUBSYSTEM_XBOX						14
+#define IMAGE_SUBSYSTEM_WINDOWS_BOOT_APPLICATION	16
+
+#define IMAGE_SCN_TYPE_NO_PAD				0x00000008
+#define IMAGE_SCN_CNT_CODE					0x00000020
+#define IMAGE_SCN_CNT_INITIALIZED_DATA		0x00000040
+#define IMAGE_SCN_CNT_UNINITIALIZED_DATA	0x00000080
+#define IMAGE_SCN_LNK_INFO					0x00000200
+#define IMAGE_SCN_LNK_COMDAT				0x00001000
+#define IMAGE_SCN_MEM_FARDATA				0x00008000
+#define IMAGE_SCN_MEM_PURGEABLE				0x00020000
+#define IMAGE_SCN_MEM_16BIT					0x00020000
+#define IMAGE_SCN_MEM_LOCKED				0x00040000
+#define IMAGE_SCN_MEM_PRELOAD				0x00080000
+#define IMAGE_SCN_ALIGN_1BYTES				0x00100000
+#define IMAGE_SCN_ALIGN_2BYTES				0x00200000
+#define IMAGE_SCN_ALIGN_4BYTES				0x00300000
+#define IMAGE_SCN_ALIGN_8BYTES				0x00400000
+#define IMAGE_SCN_ALIGN_16BYTES				0x00500000
+#define IMAGE_SCN_ALIGN_32BYTES				0x00600000
+#define IMAGE_SCN_ALIGN_64BYTES				0x00700000
+#define IMAGE_SCN_LNK_NRELOC_OVFL			0x01000000
+#define IMAGE_SCN_MEM_DISCARDABLE			0x02000000
+#define IMAGE_SCN_MEM_NOT_CACHED			0x04000000
+#define IMAGE_SCN_MEM_NOT_PAGED				0x08000000
+#define IMAGE_SCN_MEM_SHARED				0x10000000
+#define IMAGE_SCN_MEM_EXECUTE				0x20000000
+#define IMAGE_SCN_MEM_READ					0x40000000
+#define IMAGE_SCN_MEM_WRITE					0x80000000
+//@}
+
+//------------------------------------------------------------------------
+///@name imagehlp
+//@{
+struct LIST_ENTRY {
+	LIST_ENTRY* Flink;
+	LIST_ENTRY* Blink;
+};
+
+struct LOADED_IMAGE {
+	PSTR ModuleName;
+	HANDLE hFile;
+	PUCHAR MappedAddress;
+	PIMAGE_NT_HEADERS FileHeader;
+	PIMAGE_SECTION_HEADER LastRvaSection;
+	ULONG NumberOfSections;
+	PIMAGE_SECTION_HEADER Sections;
+	ULONG Characteristics;
+	BOOL fSystemImage;
+	BOOL fDOSImage;
+	BOOL fReadOnly;
+	UCHAR Version;
+	LIST_ENTRY Links;
+	ULONG SizeOfImage;		///< imagehlp ƓAt@C̃TCY.
+};
+
+/** baseɃ}bvC[WNTwb_Ԃ. DOS/NT̏NULL. ͈͌͂Ȃ. */
+PIMAGE_NT_HEADERS ImageNtHeader(void* base);
+
+/** t@CǂݎpŃ}bvAloadedݒ肷. dllPath, dotDll, readOnly ͖.
+ * sFALSEԂAerrnoɗRc.
+ */
+BOOL MapAndLoad(PSTR imageName, const char* dllPath, LOADED_IMAGE* loaded, BOOL dotDll, BOOL readOnly);
+
+/** MapAndLoad œ}bv. */
+BOOL UnMapAndLoad(LOADED_IMAGE* loaded);
+//@}
+
+//------------------------------------------------------------------------
+///@name CRT̃t@Cƃt@C
+//@{
+/** pX𕪉. ؂L'/''\\'. drive͏ɋ󕶎ɂȂ. */
+void _splitpath(const char* path, char* drive, char* dir, char* fname, char* ext);
+
+/** pXgݗĂ. dir̖ɋ؂L'/'₤. */
+void _makepath(char* path, const char* drive, const char* dir, const char* fname, const char* ext);
+
+#define _A_SUBDIR	0x10
+
+struct _finddata_t {
+	unsigned attrib;
+	long size;
+	char name[_MAX_FNAME];
+};
+
+/** pathname(tH_+ChJ[h)ɍvŏ̍ڂT. 啶͖.
+ * @return nh. Ȃ-1.
+ */
+long _findfirst(const char* pathname, _finddata_t* data);
+
+/** ̍ڂT. @retval 0 . @retval -1 I[. */
+int _findnext(long handle, _finddata_t* data);
+
+int _findclose(long handle);
+
+inline char* _strdup(const char* s)
+{
+	return strdup(s);
+}
+
+#define _snprintf	snprintf
+//@}
+
+//------------------------------------------------------------------------
+///@name }`oCg̔r. POSIX̃t@CUTF-8Ȃ̂ŁAASCII啶𓯈ꎋ.
+//@{
+inline int _mbscmp(const UCHAR* s1, const UCHAR* s2)
+{
+	return strcmp((const char*)s1, (const char*)s2);
+}
+
+inline int _mbsicmp(const UCHAR* s1, const UCHAR* s2)
+{
+	return strcasecmp((const char*)s1, (const char*)s2);
+}
+//@}
+
+#endif // EXEDIFF_POSIX_H
@@ -0,0 +1,492 @@
+/**@file exediff_test.cpp -- regression test of exediff compare engine.
+ * PEt@CƃtH_ɏoACompare ̖߂lm߂.
+ * ctest ƃtH_ƂĎs.
+ * @author Hiroshi Kuno <hkuno-exediff-tool@microhouse.co.jp>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#define MKDIR(dir)	_mkdir(dir)
+#define dup		_dup
+#define dup2	_dup2
+#define fileno	_fileno
+#define close	_close
+#else
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#define MKDIR(dir)	mkdir(dir, 0777)
+#endif
+#include "exediff.h"
+#include "mkpe.h"
+#include "mkzip.h"
+
+//------------------------------------------------------------------------
+// eXg̎s
+//........................................................................
+/** ƃtH_ */
+static const char* gWorkDir = "test_data";
+
+/** seXg̐ */
+static int gFailures = 0;
+
+/** ƃtH_̃pXԂ. ߂ľ͎Ăяo܂ŗL. */
+static const char* work_path(const char* name)
+{
+	static char buf[2][1024];
+	static int n = 0;
+	char* path = buf[n ^= 1];
+	sprintf(path, "%s/%s", gWorkDir, name);
+	return path;
+}
+
+/** eXgt@C𐶐. seXg𒆒f. */
+static void make(const char* name, unsigned timestamp, int patch = -1, const char* overlay = NULL, unsigned text_size = 0)
+{
+	PeSpec spec = { timestamp, patch, overlay, text_size };
+	if (!write_pe(work_path(name), spec)) {
+		fprintf(stderr, "%s: %s\n", work_path(name), strerror(errno));
+		exit(2);
+	}
+}
+
+/** ƃtH_̃t@Co[ƂZIPɂ. seXg𒆒f. */
+static void make_zip(const char* name, const ZipSpec* members, size_t n)
+{
+	ZipSpec specs[16];
+	char files[16][1024];
+	for (size_t i = 0; i < n; ++i) {
+		specs[i] = members[i];
+		strcpy(files[i], work_path(members[i].file));
+		specs[i].file = files[i];
+	}
+	if (!write_zip(work_path(name), specs, n)) {
+		fprintf(stderr, "%s: %s\n", work_path(name), strerror(errno));
+		exit(2);
+	}
+}
+
+/** ƃtH_ɃtH_. seXg𒆒f. */
+static void make_dir(const char* name)
+{
+	if (MKDIR(work_path(name)) != 0 && errno != EEXIST) {
+		fprintf(stderr, "%s: %s\n", work_path(name), strerror(errno));
+		exit(2);
+	}
+}
+
+/** ƃtH_̃t@CoffsetɂsizeoCgAgGfBAvalueŏ. */
+static void patch(const char* name, long offset, unsigned long value, int size)
+{
+	FILE* fp = fopen(work_path(name), "r+b");
+	if (fp == NULL) {
+		fprintf(stderr, "%s: %s\n", work_path(name), strerror(errno));
+		exit(2);
+	}
+	fseek(fp, offset, SEEK_SET);
+	for (int i = 0; i < size; ++i)
+		fputc((int)(value >> (i * 8)) & 0xff, fp);
+	fclose(fp);
+}
+
+/** ƃtH_from̐擪sizeoCgAtoƂďo. */
+static void copy_head(const char* from, const char* to, size_t size)
+{
+	size_t n;
+	unsigned char* data = mkzip_read(work_path(from), n);
+	FILE* fp = fopen(work_path(to), "wb");
+	if (data == NULL || fp == NULL || fwrite(data, n < size ? n : size, 1, fp) != 1) {
+		fprintf(stderr, "%s: %s\n", work_path(to), strerror(errno));
+		exit(2);
+	}
+	fclose(fp);
+	free(data);
+}
+
+/** WG[(fd1ȂWo)ւ̏o͂ꎞt@CɎ荞. */
+static FILE* gCapture = NULL;
+static int gCaptureFd = 2;
+static int gSavedFd = -1;
+
+static void begin_capture(int fd = 2)
+{
+	fflush(NULL);
+	gCapture = tmpfile();
+	gCaptureFd = fd;
+	gSavedFd = dup(fd);
+	dup2(fileno(gCapture), fd);
+}
+
+/** 荞݂IA荞񂾏o͂text܂܂邩Ԃ. */
+static bool end_capture(const char* text)
+{
+	fflush(NULL);
+	dup2(gSavedFd, gCaptureFd);
+	close(gSavedFd);
+	char buf[4096];
+	size_t n = 0;
+	rewind(gCapture);
+	n = fread(buf, 1, sizeof(buf) - 1, gCapture);
+	buf[n] = '\0';
+	fclose(gCapture);
+	return strstr(buf, text) != NULL;
+}
+
+/** Compare(name1, name2) ̖߂lexpectƓm߂. */
+static void expect_compare(const char* title, const char* name1, const char* name2, int expect)
+{
+	char path1[1024];
+	strcpy(path1, work_path(name1));
+	int ret = Compare(path1, work_path(name2));
+	printf("%-4s %s: Compare(%s, %s) = %d\n", ret == expect ? "ok" : "FAIL", title, name1, name2, ret);
+	if (ret != expect)
+		++gFailures;
+}
+
+/** CompareFolder(dir1, dir2, wild) ̖߂lexpectƓm߂. */
+static void expect_folder(const char* title, const char* dir1, const char* dir2, const char* wild, int expect)
+{
+	char path1[1024];
+	strcpy(path1, work_path(dir1));
+	int ret = CompareFolder(path1, work_path(dir2), wild);
+	printf("%-4s %s: CompareFolder(%s, %s, %s) = %d\n", ret == expect ? "ok" : "FAIL", title, dir1, dir2, wild, ret);
+	if (ret != expect)
+		++gFailures;
+}
+
+#ifndef _WIN32
+/** 풓[h1v socketpair ŉA˗ɕԂIR[hƏo͂m߂.
+ *  fork qvZX ServeConnection Ă. fdɏꂽo͂text܂܂邱.
+ */
+static void expect_request(const char* title, const char* const* args, int expect, int fd, const char* text)
+{
+	char* argv[16];
+	char paths[16][1024];
+	int argc = 0;
+	argv[argc++] = (char*)"exediff";
+	for (; *args != NULL; ++args, ++argc) {
+		strcpy(paths[argc], **args == '-' ? *args : work_path(*args));
+		argv[argc] = paths[argc];
+	}
+	argv[argc] = NULL;
+
+	int sv[2];
+	int ret = -1;
+	bool found = false;
+	begin_capture(fd);
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			close(sv[0]);
+			ServeConnection(sv[1]);
+			_exit(0);
+		}
+		close(sv[1]);
+		ret = SendRequest(sv[0], "socketpair", argc, argv);
+		close(sv[0]);
+		if (pid > 0)
+			waitpid(pid, NULL, 0);
+	}
+	found = end_capture(text);
+	printf("%-4s %s: request = %d, %s\n", ret == expect && found ? "ok" : "FAIL", title, ret,
+		found ? "output relayed" : "output missing");
+	if (ret != expect || !found)
+		++gFailures;
+}
+#endif
+
+/** IvVlɖ߂. */
+static void reset_options()
+{
+	gIgnoreTimeStamp = false;
+	gIgnoreCheckSum = false;
+	gDumpFileImage = false;
+	gQuiet = true;
+	gDiffLength = 4;
+	gCompareAll = false;
+	gBrief = false;
+	gProfile = false;
+	gDirDiff = false;
+	gRenameThreshold = 0;
+	gThreads = 0;
+}
+
+/** C֐ */
+int main(int argc, char* argv[])
+{
+	if (argc > 1)
+		gWorkDir = argv[1];
+	if (MKDIR(gWorkDir) != 0 && errno != EEXIST) {
+		fprintf(stderr, "%s: %s\n", gWorkDir, strerror(errno));
+		return 2;
+	}
+	make("base.dll",    0x40000000);
+	make("same.dll",    0x40000000);
+	make("patch.dll",   0x40000000, 0x123);
+	make("stamp.dll",   0x40000001);
+	make("overlay.dll", 0x40000000, -1, "appended payload");
+
+	reset_options();
+	expect_compare("identical", "base.dll", "same.dll", 0);
+	expect_compare("byte differ", "base.dll", "patch.dll", 1);
+	expect_compare("timestamp differ", "base.dll", "stamp.dll", 1);
+	expect_compare("missing file", "base.dll", "missing.dll", 2);
+	expect_compare("overlay ignored", "base.dll", "overlay.dll", 0);
+
+	gIgnoreTimeStamp = true;
+	expect_compare("-t timestamp ignored", "base.dll", "stamp.dll", 0);
+	expect_compare("-t byte differ", "base.dll", "patch.dll", 1);
+
+	reset_options();
+	gCompareAll = true;
+	expect_compare("-a overlay differ", "base.dll", "overlay.dll", 1);
+	expect_compare("-a identical", "base.dll", "same.dll", 0);
+	// DataDirectory  diff_header rȂ̂ŁA-a ̃wb_̈̃oCgrŌ.
+	make("datadir.dll", 0x40000000);
+	patch("datadir.dll", MKPE_PE_OFFSET + 24 + 96 + 8, 0x2000, 4);	// DataDirectory[1].VirtualAddress
+	expect_compare("-a data directory differ", "base.dll", "datadir.dll", 1);
+	gIgnoreTimeStamp = true;
+	expect_compare("-a -t timestamp ignored", "base.dll", "stamp.dll", 0);
+	gBrief = true;
+	gDiffLength = 0;
+	expect_compare("-a --brief data directory differ", "base.dll", "datadir.dll", 1);
+
+	reset_options();
+	gProfile = true;
+	expect_compare("-e -q byte differ", "base.dll", "patch.dll", 1);
+	gQuiet = false;
+	expect_compare("-e byte differ", "base.dll", "patch.dll", 1);
+
+	reset_options();
+	gBrief = true;
+	gDiffLength = 0;
+	expect_compare("--brief identical", "base.dll", "same.dll", 0);
+	expect_compare("--brief byte differ", "base.dll", "patch.dll", 1);
+	expect_compare("--brief missing file", "missing.dll", "base.dll", 2);
+	// 傫ȃZNV͋Ԃɕĕsɔr. Ō̋ԂقȂꍇł؂炸Ɍ.
+	const unsigned big = 8 * 1024 * 1024;
+	make("big.dll",      0x40000000, -1,      NULL, big);
+	make("bigsame.dll",  0x40000000, -1,      NULL, big);
+	make("bighead.dll",  0x40000000, 0,       NULL, big);
+	make("bigtail.dll",  0x40000000, big - 1, NULL, big);
+	gThreads = 4;
+	expect_compare("--brief -j4 identical", "big.dll", "bigsame.dll", 0);
+	expect_compare("--brief -j4 first chunk differ", "big.dll", "bighead.dll", 1);
+	expect_compare("--brief -j4 last chunk differ", "big.dll", "bigtail.dll", 1);
+	gThreads = 64;
+	expect_compare("--brief -j64 last chunk differ", "bigtail.dll", "big.dll", 1);
+	gThreads = 0;
+
+	// ǂݍݍς݂̃t@CꂽALbṼC[Wg킸ɓǂݍݒ.
+	reset_options();
+	gCompareAll = true;
+	make("rewrite.dll", 0x40000000);
+	expect_compare("cached identical", "base.dll", "rewrite.dll", 0);
+	make("rewrite.dll", 0x40000000, -1, "appended payload");
+	expect_compare("rewritten differ", "base.dll", "rewrite.dll", 1);
+
+	// ZIPɂ̃o[. O͑啶𖳎ĒT.
+	reset_options();
+	static const ZipSpec zip1[] = {
+		{ "bin/Base.dll",  "base.dll",  0, 0 },
+		{ "bin/patch.dll", "patch.dll", 8, 0 },
+		{ "same.dll",      "same.dll",  8, 0 },
+	};
+	make_zip("z1.zip", zip1, 3);
+	expect_compare("zip stored member", "z1.zip!bin/base.dll", "base.dll", 0);
+	expect_compare("zip deflated member", "z1.zip!SAME.DLL", "base.dll", 0);
+	expect_compare("zip deflated differ", "z1.zip!bin/patch.dll", "base.dll", 1);
+	expect_compare("zip deflated patch", "patch.dll", "z1.zip!bin/patch.dll", 0);
+	expect_compare("zip crc shortcut", "z1.zip!bin/Base.dll", "z1.zip!same.dll", 0);
+	expect_compare("zip missing member", "z1.zip!bin/missing.dll", "base.dll", 2);
+	static const ZipSpec zip2[] = {
+		{ "truncated.dll", "base.dll", 8, 1 },
+		{ "badblock.dll",  "base.dll", 8, 2 },
+		{ "badcrc.dll",    "base.dll", 0, 3 },
+		{ "huge.dll",      "base.dll", 8, 4 },
+		{ "hugestore.dll", "base.dll", 0, 4 },
+	};
+	make_zip("broken.zip", zip2, 5);
+	expect_compare("zip truncated deflate", "broken.zip!truncated.dll", "base.dll", 2);
+	expect_compare("zip bad block type", "broken.zip!badblock.dll", "base.dll", 2);
+	expect_compare("zip crc mismatch", "broken.zip!badcrc.dll", "base.dll", 2);
+	expect_compare("zip huge deflated size", "broken.zip!huge.dll", "base.dll", 2);
+	expect_compare("zip huge stored size", "broken.zip!hugestore.dll", "base.dll", 2);
+	// ɂ̃LbV2. gp̏ɂ́A3ڂJĂ̂ĂȂ.
+	static const ZipSpec zipa[] = { { "x.dll", "base.dll",  8, 0 } };
+	static const ZipSpec zipc[] = { { "x.dll", "patch.dll", 8, 0 } };
+	make_zip("a.zip", zipa, 1);
+	make_zip("b.zip", zipa, 1);
+	make_zip("c.zip", zipc, 1);
+	expect_compare("zip a/c differ", "a.zip!x.dll", "c.zip!x.dll", 1);
+	expect_compare("zip a/b after a/c", "a.zip!x.dll", "b.zip!x.dll", 0);
+	expect_compare("zip c/b after a/b", "c.zip!x.dll", "b.zip!x.dll", 1);
+	expect_folder("zip folder after a/b/c", "a.zip", "b.zip", "*", 0);
+
+	// ꂽPEt@C. ͈͊Oǂ܂ɁAǂݍݎsƂ邩܂͈͂ɐ؂l߂.
+	// wb_̈ʒu mkpe.h ɂ: ZNV\ 0x178 A.data ̃wb_ 0x1a0 .
+	reset_options();
+	copy_head("base.dll", "trunc1.dll", 0x700);		// .data ̓rŐ؂.
+	copy_head("base.dll", "trunc2.dll", 0x700);
+	begin_capture();
+	int ret = Compare(work_path("trunc1.dll"), work_path("trunc2.dll"));
+	bool warned = end_capture("exceeds file size, truncated");
+	printf("%-4s truncated file: Compare(trunc1.dll, trunc2.dll) = %d, %s\n",
+		ret == 0 && warned ? "ok" : "FAIL", ret, warned ? "warned" : "no warning");
+	if (ret != 0 || !warned)
+		++gFailures;
+	expect_compare("truncated file differ", "base.dll", "trunc1.dll", 1);
+	make("rawbig.dll", 0x40000000);
+	patch("rawbig.dll", 0x1a0 + 8,  0x10000, 4);	// VirtualSize
+	patch("rawbig.dll", 0x1a0 + 16, 0x10000, 4);	// SizeOfRawData
+	begin_capture();
+	ret = Compare(work_path("rawbig.dll"), work_path("rawbig.dll"));
+	warned = end_capture("exceeds file size, truncated");
+	printf("%-4s SizeOfRawData past EOF: Compare(rawbig.dll, rawbig.dll) = %d, %s\n",
+		ret == 0 && warned ? "ok" : "FAIL", ret, warned ? "warned" : "no warning");
+	if (ret != 0 || !warned)
+		++gFailures;
+	make("nsec.dll", 0x40000000);
+	patch("nsec.dll", MKPE_PE_OFFSET + 6, 0xffff, 2);	// NumberOfSections
+	expect_compare("huge NumberOfSections", "nsec.dll", "base.dll", 2);
+	make("lfanew1.dll", 0x40000000);
+	patch("lfanew1.dll", 0x3c, 0x7ffffff0, 4);
+	expect_compare("e_lfanew past EOF", "lfanew1.dll", "base.dll", 2);
+	make("lfanew2.dll", 0x40000000);
+	patch("lfanew2.dll", 0x3c, 0x80000000, 4);
+	expect_compare("negative e_lfanew", "base.dll", "lfanew2.dll", 2);
+	copy_head("base.dll", "tiny.dll", 0x20);
+	expect_compare("shorter than DOS header", "tiny.dll", "base.dll", 2);
+	// .text ̃f[^wb_ƏdȂƁAwb_̈NTwb_̐擪납n܂.
+	// -a -t / -a -c Ŗ鍀ڂ́Ä̐擪ł͂Ȃt@C̈ʒuŒT.
+	static const char* const overlap[] = { "hdrsec1.dll", "hdrsec2.dll", "hdrsec3.dll" };
+	make("hdrsec1.dll", 0x40000000);
+	make("hdrsec2.dll", 0x40000001);
+	make("hdrsec3.dll", 0x40000000);
+	patch("hdrsec3.dll", MKPE_PE_OFFSET + 24 + 64, 0x1234, 4);	// OptionalHeader.CheckSum
+	for (int i = 0; i < 3; ++i) {
+		patch(overlap[i], 0x178 + 16, 0x44, 4);		// SizeOfRawData: 0x40..0x84  TimeDateStamp ̎O܂.
+		patch(overlap[i], 0x178 + 20, 0x40, 4);		// PointerToRawData
+	}
+	gCompareAll = true;
+	expect_compare("-a headers overlapped timestamp differ", "hdrsec1.dll", "hdrsec2.dll", 1);
+	expect_compare("-a headers overlapped checksum differ", "hdrsec1.dll", "hdrsec3.dll", 1);
+	gIgnoreTimeStamp = true;
+	expect_compare("-a -t headers overlapped", "hdrsec1.dll", "hdrsec2.dll", 0);
+	gIgnoreCheckSum = true;
+	expect_compare("-a -c headers overlapped", "hdrsec1.dll", "hdrsec3.dll", 0);
+	// TimeDateStamp ZNVf[^ɂ΁Awb_̈ł͉BȂ.
+	patch("hdrsec1.dll", 0x178 + 16, 0x90, 4);
+	patch("hdrsec2.dll", 0x178 + 16, 0x90, 4);
+	expect_compare("-a -t timestamp in overlapping section", "hdrsec1.dll", "hdrsec2.dll", 1);
+	reset_options();
+
+	// fBNgr. DIR1̓t@C͑啶𖳎ĒTAtH_͔rȂ.
+	reset_options();
+	make_dir("dir1");
+	make_dir("dir2");
+	make_dir("dir2/beta2.dll");
+	make("dir1/Alpha.dll",  0x40000000);
+	make("dir1/beta.dll",   0x40000000);
+	make("dir1/gamma.dll",  0x40000000);
+	make("dir1/readme.txt", 0x40000000);
+	make("dir2/ALPHA.DLL",  0x40000000);
+	make("dir2/beta.dll",   0x40000000);
+	make("dir2/gamma.dll",  0x40000000, 0x123);
+	make("dir2/readme.txt", 0x40000001);
+	make("dir2/delta.dll",  0x40000000);
+	expect_folder("folder case folding", "dir1", "dir2", "alpha.dll", 0);
+	expect_folder("folder '?' wildcard", "dir1", "dir2", "?LPHA.*", 0);
+	expect_folder("folder '*' skips folders", "dir1", "dir2", "b*.dll", 0);
+	expect_folder("folder byte differ", "dir1", "dir2", "g*a.dll", 1);
+	expect_folder("folder '*' in middle", "dir1", "dir2", "*e*.t?t", 1);
+	expect_folder("folder missing in dir1", "dir1", "dir2", "d*", 2);
+	expect_folder("folder no match", "dir1", "dir2", "*.exe", 0);
+	// DIR1̍ WILD Ɋւ炸St@ĈŁAxg.
+	make_dir("many1");
+	make_dir("many2");
+	for (int i = 0; i < 300; ++i) {
+		char name1[64], name2[64];
+		sprintf(name1, "many1/file_with_a_long_name_%03d.dll", i);
+		sprintf(name2, "many2/FILE_WITH_A_LONG_NAME_%03d.DLL", i);
+		make(name1, 0x40000000);
+		make(name2, 0x40000000, i == 299 ? 0x10 : -1);
+	}
+	expect_folder("many files identical", "many1", "many2", "*_?5?.dll", 0);
+	expect_folder("many files differ", "many1", "many2", "*_29?.dll", 1);
+	// -p0 Ȃǂ݂Ȃ. ʂ͐ǂ݂ꍇƓ.
+	gPrefetchCount = 0;
+	expect_folder("-p0 many files differ", "many1", "many2", "*_29?.dll", 1);
+	gPrefetchCount = 4;
+
+	// ̑Ήt. .text  .data 1ubNȂȃt@CłA
+	// Ŝ̃oCgrŗގx߂đΉt.
+	reset_options();
+	make_dir("ren1");
+	make_dir("ren2");
+	make("ren1/a_old.dll", 0x40000000);
+	make("ren2/a_new.dll", 0x40000000);
+	make("ren1/b_old.dll", 0x50000000);
+	make("ren2/b_new.dll", 0x50000000, 0x10);
+	make("ren1/c_old.dll", 0x60000000, -1, NULL, 0x8000);
+	make("ren2/c_new.dll", 0x60000000, 0x10, NULL, 0x8000);
+	expect_folder("rename off", "ren1", "ren2", "a_*", 2);
+	gRenameThreshold = 50;
+	expect_folder("rename small identical", "ren1", "ren2", "a_*", 0);
+	expect_folder("rename small differ", "ren1", "ren2", "b_*", 1);
+	expect_folder("rename large differ", "ren1", "ren2", "c_*", 1);
+	expect_folder("rename all", "ren1", "ren2", "*", 1);
+	gRenameThreshold = 100;
+	expect_folder("rename below threshold", "ren1", "ren2", "b_*", 2);
+
+#ifndef _WIN32
+	// 풓[h̗v. IvV͗vƂɊl͂Ao͈͂˗̕Wo͂ƕWG[ɏ.
+	reset_options();
+	static const char* const req1[] = { "base.dll", "patch.dll", NULL };
+	expect_request("serve differ", req1, 1, 1, "+00000123: ");
+	static const char* const req2[] = { "-q", "base.dll", "same.dll", NULL };
+	expect_request("serve identical", req2, 0, 1, "are identical");
+	static const char* const req3[] = { "base.dll", "missing.dll", NULL };
+	expect_request("serve missing file", req3, 2, 2, "missing.dll");
+	// 풓vZXŗĂIvVAO̗ṽIvVzȂ.
+	gCompareAll = true;
+	gDiffLength = 0;
+	static const char* const req5[] = { "-a", "base.dll", "overlay.dll", NULL };
+	expect_request("serve with -a", req5, 1, 1, "Overlay[1]");
+	static const char* const req6[] = { "base.dll", "overlay.dll", NULL };
+	expect_request("serve defaults restored", req6, 0, 1, "are identical");
+	reset_options();
+	static const char* const req4[] = { "-s", "served.snap", "base.dll", NULL };
+	expect_request("serve refuses -s", req4, 1, 2, "cannot request -s");
+	FILE* fp = fopen(work_path("served.snap"), "rb");
+	printf("%-4s serve refuses -s: served.snap %s\n", fp == NULL ? "ok" : "FAIL", fp == NULL ? "not written" : "written");
+	if (fp != NULL) {
+		fclose(fp);
+		++gFailures;
+	}
+#endif
+
+	reset_options();
+	char snap[1024];
+	strcpy(snap, work_path("base.snap"));
+	ret = WriteSnapshot(snap, work_path("base.dll"));
+	printf("%-4s snapshot: WriteSnapshot(base.snap, base.dll) = %d\n", ret == 0 ? "ok" : "FAIL", ret);
+	if (ret != 0)
+		++gFailures;
+	expect_compare("snapshot identical", "base.snap", "same.dll", 0);
+	expect_compare("snapshot byte differ", "base.snap", "patch.dll", 1);
+	expect_compare("snapshot overlay ignored", "base.snap", "overlay.dll", 0);
+	expect_compare("snapshot file crc", "same.dll", "base.snap", 0);
+	gBrief = true;
+	gDiffLength = 0;
+	expect_compare("--brief snapshot file crc", "base.snap", "same.dll", 0);
+	expect_compare("--brief snapshot differ", "base.snap", "stamp.dll", 1);
+
+	printf("%d failure(s)\n", gFailures);
+	return gFailures == 0 ? 0 : 1;
+}
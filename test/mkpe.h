@@ -0,0 +1,114 @@
+/**@file mkpe.h -- PE file generator for exediff test and benchmark.
+ * .text  .data 2ZNVŏPE32t@Co.
+ * @author Hiroshi Kuno <hkuno-exediff-tool@microhouse.co.jp>
+ */
+#ifndef MKPE_H
+#define MKPE_H
+#include <stdio.h>
+#include <string.h>
+
+/** PEt@C̓e. */
+struct PeSpec {
+	unsigned timestamp;			///< FileHeader.TimeDateStamp
+	int patch;					///< .text̏ʒu. Ȃ珑Ȃ.
+	const char* overlay;		///< ɒǉf[^. NULLȂǉȂ.
+	unsigned text_size;			///< .text̑傫. 0Ȃ0x400. 0x200̔{Ƃ.
+};
+
+/** PEt@C̊ëʒu. t@CACg0x200Ƃ. */
+enum {
+	MKPE_PE_OFFSET   = 0x80,
+	MKPE_OPT_SIZE    = 224,		///< sizeof(IMAGE_OPTIONAL_HEADER32)
+	MKPE_HEADER_SIZE = 0x200,
+	MKPE_DATA_SIZE   = 0x200,
+};
+
+inline void mkpe_put16(unsigned char* p, unsigned v)
+{
+	p[0] = (unsigned char)v; p[1] = (unsigned char)(v >> 8);
+}
+
+inline void mkpe_put32(unsigned char* p, unsigned v)
+{
+	mkpe_put16(p, v & 0xffff); mkpe_put16(p + 2, v >> 16);
+}
+
+/** ZNVwb_. */
+inline void mkpe_section(unsigned char* p, const char* name, unsigned va, unsigned size, unsigned offset, unsigned flags)
+{
+	strncpy((char*)p, name, 8);
+	mkpe_put32(p + 8, size);		// VirtualSize
+	mkpe_put32(p + 12, va);
+	mkpe_put32(p + 16, size);		// SizeOfRawData
+	mkpe_put32(p + 20, offset);
+	mkpe_put32(p + 36, flags);
+}
+
+/** .text̓e. @B炵A0̘AƕsKȃoCg݂ɕׂ. */
+inline unsigned char mkpe_text_byte(unsigned i)
+{
+	if ((i >> 6) % 5 == 0)
+		return 0;
+	unsigned x = i * 2654435761u;
+	return (unsigned char)((x >> 24) ^ (x >> 13));
+}
+
+/** specɏ]A.text  .data PE32t@Co.
+ * @retval true 
+ */
+inline bool write_pe(const char* fname, const PeSpec& spec)
+{
+	const unsigned text = spec.text_size ? spec.text_size : 0x400;
+	const unsigned text_va = 0x1000;
+	const unsigned data_va = text_va + (text + 0xfff) / 0x1000 * 0x1000;
+	unsigned char header[MKPE_HEADER_SIZE];
+	memset(header, 0, sizeof(header));
+	mkpe_put16(header, 0x5a4d);					// "MZ"
+	mkpe_put32(header + 0x3c, MKPE_PE_OFFSET);
+	unsigned char* nt = header + MKPE_PE_OFFSET;
+	mkpe_put32(nt, 0x4550);						// "PE\0\0"
+	mkpe_put16(nt + 4, 0x14c);					// i386
+	mkpe_put16(nt + 6, 2);						// NumberOfSections
+	mkpe_put32(nt + 8, spec.timestamp);
+	mkpe_put16(nt + 20, MKPE_OPT_SIZE);
+	mkpe_put16(nt + 22, 0x0102);				// EXECUTABLE_IMAGE | 32BIT_MACHINE
+	unsigned char* opt = nt + 24;
+	mkpe_put16(opt, 0x10b);						// PE32
+	mkpe_put32(opt + 4, text);					// SizeOfCode
+	mkpe_put32(opt + 16, text_va);				// AddressOfEntryPoint
+	mkpe_put32(opt + 28, 0x400000);				// ImageBase
+	mkpe_put32(opt + 32, 0x1000);				// SectionAlignment
+	mkpe_put32(opt + 36, 0x200);				// FileAlignment
+	mkpe_put16(opt + 40, 4);					// MajorOperatingSystemVersion
+	mkpe_put16(opt + 48, 4);					// MajorSubsystemVersion
+	mkpe_put32(opt + 56, data_va + 0x1000);		// SizeOfImage
+	mkpe_put32(opt + 60, MKPE_HEADER_SIZE);		// SizeOfHeaders
+	mkpe_put16(opt + 68, 3);					// console
+	mkpe_put32(opt + 92, 16);					// NumberOfRvaAndSizes
+	unsigned char* sec = opt + MKPE_OPT_SIZE;
+	mkpe_section(sec,      ".text", text_va, text, MKPE_HEADER_SIZE, 0x60000020);
+	mkpe_section(sec + 40, ".data", data_va, MKPE_DATA_SIZE, MKPE_HEADER_SIZE + text, 0xc0000040);
+
+	FILE* fp = fopen(fname, "wb");
+	if (fp == NULL)
+		return false;
+	bool ok = fwrite(header, sizeof(header), 1, fp) == 1;
+	unsigned char buf[0x10000];
+	for (unsigned pos = 0; ok && pos < text; pos += sizeof(buf)) {
+		unsigned len = text - pos < sizeof(buf) ? text - pos : (unsigned)sizeof(buf);
+		for (unsigned i = 0; i < len; ++i)
+			buf[i] = mkpe_text_byte(pos + i);
+		if (spec.patch >= 0 && (unsigned)spec.patch - pos < len)
+			buf[spec.patch - pos] ^= 0xff;
+		ok = fwrite(buf, len, 1, fp) == 1;
+	}
+	unsigned char data[MKPE_DATA_SIZE];
+	memset(data, 0, sizeof(data));
+	memcpy(data, "exediff test data", 17);
+	ok = ok && fwrite(data, sizeof(data), 1, fp) == 1;
+	if (spec.overlay != NULL)
+		ok = ok && fputs(spec.overlay, fp) >= 0;
+	return fclose(fp) == 0 && ok;
+}
+
+#endif // MKPE_H
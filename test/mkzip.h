@@ -0,0 +1,208 @@
+/**@file mkzip.h -- zip archive generator for exediff test.
+ * t@Co[ƂZIPɂo. k͖k(stored)ƁA
+ * Œnt}ɂdeflatê݂Ƃ. ꂽɂ邽߂̍׍Hł.
+ * @author Hiroshi Kuno <hkuno-exediff-tool@microhouse.co.jp>
+ */
+#ifndef MKZIP_H
+#define MKZIP_H
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** oo[. */
+struct ZipSpec {
+	const char* name;			///< ɓpX.
+	const char* file;			///< eǂރt@C.
+	int method;					///< 0:stored, 8:deflated
+	int damage;					///< 0:Ȃ 1:kf[^𔼕ɐ؂l߂ 2:sȃubN` 3:CRC32sv 4:LTCY0xFFFFFFFFƋU
+};
+
+/** CRC32(ISO 3309). */
+inline unsigned long mkzip_crc32(const unsigned char* p, size_t n)
+{
+	unsigned long crc = 0xFFFFFFFFUL;
+	while (n--) {
+		crc ^= *p++;
+		for (int k = 0; k < 8; ++k)
+			crc = (crc & 1) ? 0xEDB88320UL ^ (crc >> 1) : crc >> 1;
+	}
+	return ~crc & 0xFFFFFFFFUL;
+}
+
+/** LSBl߂rbg. */
+struct MkzipBits {
+	unsigned char* out;
+	size_t pos;
+	unsigned long buf;
+	int cnt;
+
+	void put(unsigned long value, int n) {
+		buf |= value << cnt;
+		cnt += n;
+		while (cnt >= 8) {
+			out[pos++] = (unsigned char)buf;
+			buf >>= 8;
+			cnt -= 8;
+		}
+	}
+	/** nt}͏ʃrbgl߂. */
+	void huff(unsigned code, int len) {
+		while (len--)
+			put((code >> len) & 1, 1);
+	}
+	void symbol(unsigned sym) {
+		if (sym < 144)      huff(0x30 + sym, 8);
+		else if (sym < 256) huff(0x190 + sym - 144, 9);
+		else if (sym < 280) huff(sym - 256, 7);
+		else                huff(0xC0 + sym - 280, 8);
+	}
+	size_t flush() {
+		if (cnt > 0)
+			put(0, 8 - cnt);
+		return pos;
+	}
+};
+
+/** Œnt}1ubNdeflate. oCg̘A͋1̈vƂĕ.
+ * @param out	n + n / 8 + 16 oCgȏ.
+ * @return k̃oCg.
+ */
+inline size_t mkzip_deflate(const unsigned char* in, size_t n, unsigned char* out)
+{
+	static const unsigned short lbase[29] = {
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static const unsigned char lext[29] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	MkzipBits bits = { out, 0, 0, 0 };
+	bits.put(1, 1);		// BFINAL
+	bits.put(1, 2);		// BTYPE: fixed Huffman
+	for (size_t i = 0; i < n; ) {
+		size_t run = 0;
+		while (i > 0 && i + run < n && run < 258 && in[i + run] == in[i - 1])
+			++run;
+		if (run < 3) {
+			bits.symbol(in[i++]);
+			continue;
+		}
+		int k = 28;
+		while (lbase[k] > run)
+			--k;
+		bits.symbol(257 + k);
+		bits.put(run - lbase[k], lext[k]);
+		bits.huff(0, 5);	// distance 1
+		i += run;
+	}
+	bits.symbol(256);	// end of block
+	return bits.flush();
+}
+
+inline void mkzip_put16(unsigned char* p, unsigned v)
+{
+	p[0] = (unsigned char)v; p[1] = (unsigned char)(v >> 8);
+}
+
+inline void mkzip_put32(unsigned char* p, unsigned long v)
+{
+	mkzip_put16(p, v & 0xffff); mkzip_put16(p + 2, (unsigned)(v >> 16));
+}
+
+/** t@CŜǂ. ߂l malloc ̈. sȂNULL. */
+inline unsigned char* mkzip_read(const char* fname, size_t& size)
+{
+	FILE* fp = fopen(fname, "rb");
+	if (fp == NULL)
+		return NULL;
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	unsigned char* buf = (unsigned char*)malloc(size + 1);
+	if (buf != NULL && fread(buf, 1, size, fp) != size) {
+		free(buf);
+		buf = NULL;
+	}
+	fclose(fp);
+	return buf;
+}
+
+/** members[0..n) o[ƂZIPɂo.
+ * @retval true 
+ */
+inline bool write_zip(const char* fname, const ZipSpec* members, size_t n)
+{
+	FILE* fp = fopen(fname, "wb");
+	if (fp == NULL)
+		return false;
+	unsigned char* central = (unsigned char*)malloc(n * (46 + 256));
+	size_t cdsize = 0;
+	unsigned long offset = 0;
+	bool ok = central != NULL;
+	for (size_t i = 0; ok && i < n; ++i) {
+		const ZipSpec& m = members[i];
+		size_t size;
+		unsigned char* data = mkzip_read(m.file, size);
+		if (data == NULL) {
+			ok = false;
+			break;
+		}
+		unsigned long crc = mkzip_crc32(data, size);
+		const unsigned long declared = m.damage == 4 ? 0xFFFFFFFFUL : (unsigned long)size;
+		unsigned char* comp = data;
+		size_t compsize = size;
+		if (m.method == 8) {
+			comp = (unsigned char*)malloc(size + size / 8 + 16);
+			compsize = mkzip_deflate(data, size, comp);
+		}
+		if (m.damage == 1)
+			compsize /= 2;
+		else if (m.damage == 2)
+			comp[0] |= 0x06;	// BTYPE=3 ͗\񂳂ꂽsȌ`.
+		else if (m.damage == 3)
+			crc ^= 1;
+
+		const size_t namelen = strlen(m.name);
+		unsigned char local[30];
+		memset(local, 0, sizeof(local));
+		mkzip_put32(local, 0x04034B50);
+		mkzip_put16(local + 4, 20);
+		mkzip_put16(local + 8, m.method);
+		mkzip_put32(local + 14, crc);
+		mkzip_put32(local + 18, compsize);
+		mkzip_put32(local + 22, declared);
+		mkzip_put16(local + 26, (unsigned)namelen);
+		ok = fwrite(local, sizeof(local), 1, fp) == 1
+			&& fwrite(m.name, namelen, 1, fp) == 1
+			&& (compsize == 0 || fwrite(comp, compsize, 1, fp) == 1);
+
+		unsigned char* c = central + cdsize;
+		memset(c, 0, 46);
+		mkzip_put32(c, 0x02014B50);
+		mkzip_put16(c + 4, 20);
+		mkzip_put16(c + 6, 20);
+		mkzip_put16(c + 10, m.method);
+		mkzip_put32(c + 16, crc);
+		mkzip_put32(c + 20, compsize);
+		mkzip_put32(c + 24, declared);
+		mkzip_put16(c + 28, (unsigned)namelen);
+		mkzip_put32(c + 42, offset);
+		memcpy(c + 46, m.name, namelen);
+		cdsize += 46 + namelen;
+		offset += (unsigned long)(30 + namelen + compsize);
+		if (comp != data)
+			free(comp);
+		free(data);
+	}
+	unsigned char eocd[22];
+	memset(eocd, 0, sizeof(eocd));
+	mkzip_put32(eocd, 0x06054B50);
+	mkzip_put16(eocd + 8, (unsigned)n);
+	mkzip_put16(eocd + 10, (unsigned)n);
+	mkzip_put32(eocd + 12, cdsize);
+	mkzip_put32(eocd + 16, offset);
+	ok = ok && fwrite(central, cdsize, 1, fp) == 1 && fwrite(eocd, sizeof(eocd), 1, fp) == 1;
+	free(central);
+	return fclose(fp) == 0 && ok;
+}
+
+#endif // MKZIP_H